@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * The AI domain: the computer player runs in a process of its own (see
+ * aiprocess.c), which holds no capabilities but two endpoints: it receives
+ * requests from the one and sends its replies to the other. It cannot
+ * allocate memory, map pages, or talk to any device, and the only memory
+ * of the main thread it can see is mapped read-only.
+ *
+ * The AI domain has a board of its own (game AI_DOMAIN_GAME; see
+ * get_game()), which it keeps up to date from memory it can only read:
+ * the main thread writes the players into a page, and a log of the cells
+ * they occupied into an array with room for every cell of the board. The
+ * AI domain puts the cells onto its board in the order they were played,
+ * and starts its computer players over with each round, as the main
+ * thread does; so its board, and the work its computer players do (see
+ * region_upkeep()), are those the main thread's would have. The memory of
+ * that board and of the computer players of the AI domain is allocated by
+ * the main thread, before the process starts; the process has a copy of
+ * the main thread's data from then on (rules, weights, and the like).
+ *
+ * A request is an seL4_Send() on the request endpoint, after which the
+ * main thread waits for the reply on the reply endpoint:
+ *
+ *   AI_MOVE  MR0 player, MR1-2 endTime (low word first), MR3 level;
+ *            reply: MR0 direction, MR1 player's rng, MR2 work,
+ *            MR3-4 cycles the AI domain spent on the request
+ *   AI_NULL  nothing; measures the cost of the IPC round trip alone
+ *
+ * The main thread is blocked while the AI domain serves a request, so the
+ * shared page never changes under the AI domain's feet. Nor can it read
+ * the keyboard, which the AI domain has no access to; so, while the AI
+ * domain searches, it sends an AI_POLL message instead of the reply every
+ * POLL_NS (see ai_domain_poll()), upon which the main thread drains the
+ * keyboard and sends an AI_POLL message back on the request endpoint.
+ *
+ * The reply endpoint is the fault endpoint of the AI domain's thread too,
+ * with a badge of its own: if the thread faults, the main thread receives
+ * the fault instead of a reply, stops the process, and decides the moves
+ * itself from then on. (seL4_Call() and seL4_ReplyWait() would be cheaper,
+ * but a thread blocked in seL4_Call() waits for a reply nobody sends once
+ * the thread it called has faulted.)
+ */
+
+#include <autoconf.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sel4/sel4.h>
+#include <vka/object.h>
+#include "aidomain.h"
+#include "aiprocess.h"
+#include "board.h"
+
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+
+/* number of AI_NULL requests ai_domain_init() measures */
+#define NULL_CALLS 1000
+
+/* the AI domain lets the main thread poll the keyboard this often (ns) */
+#define POLL_NS 1000000
+
+/* request labels */
+enum { AI_NULL = 1, AI_MOVE, AI_POLL };
+
+/* a cell a player occupied */
+typedef struct {
+    coord_t pos;
+    cell_t entity;
+} log_entry_t;
+
+/* the page shared by the main thread (read-write) and the AI domain
+ * (read-only) */
+typedef struct {
+    /* incremented at the start of every round */
+    uint32_t round;
+    /* number of cells the players have occupied in this round, start
+     * cells included (in the log) */
+    uint32_t numCells;
+    /* the players at the time of the last AI_MOVE request */
+    player_t players[NUMPLAYERS];
+} shared_t;
+
+/* main thread's side */
+static shared_t* shared;
+static log_entry_t* cellLog;
+static vka_object_t endpoint;
+static vka_object_t replyEndpoint;
+/* whether the AI domain has faulted (the main thread decides the moves) */
+static int faulted = 0;
+/* result of get_computer_work() of the last move of each player */
+static unsigned long lastWork[NUMPLAYERS];
+/* cycles per request since the last report (see ai_domain_report()) */
+static unsigned long requests;
+static uint64_t decisionSum;
+static uint64_t decisionMax;
+static uint64_t ipcSum;
+static uint64_t ipcMax;
+/* cycles of an AI_NULL request */
+static uint64_t nullRequest;
+
+/* AI domain's side (only used in the process) */
+static const shared_t* view;
+static const log_entry_t* viewLog;
+static uint32_t aiRound = 0;
+static uint32_t aiRead = 0;
+static uint64_t lastPoll = 0;
+
+
+/*
+ * Bring the board of the AI domain up to date with the main thread's.
+ */
+static void
+sync_board() {
+    if (view->round != aiRound) {
+        // as init_game_newround() and run_game() in main.c: the start
+        // cells, then the computer players start over, so that their
+        // upkeep does not include an earlier round's
+        board_reset();
+        aiRound = view->round;
+        for (aiRead = 0; aiRead < NUMPLAYERS; aiRead++) {
+            put_board(viewLog[aiRead].pos, viewLog[aiRead].entity);
+        }
+        init_computer_move();
+    }
+    for (; aiRead < view->numCells; aiRead++) {
+        put_board(viewLog[aiRead].pos, viewLog[aiRead].entity);
+    }
+}
+
+
+/*
+ * Serve an AI_MOVE request.
+ * @return: length of the reply
+ */
+static int
+serve_move() {
+    const uint64_t start = read_tsc();
+    const int pl = seL4_GetMR(0);
+    const uint64_t endTime = seL4_GetMR(1) | (uint64_t)seL4_GetMR(2) << 32;
+    const int level = seL4_GetMR(3);
+
+    sync_board();
+    if (level != get_computer_level()) {
+        set_computer_level(level);
+    }
+    player_t me = view->players[pl];
+    player_t you = view->players[(pl + 1) % NUMPLAYERS];
+    direction_t dir = get_computer_move(endTime, &me, &you);
+    const uint64_t cycles = read_tsc() - start;
+
+    seL4_SetMR(0, dir);
+    seL4_SetMR(1, me.rng);
+    seL4_SetMR(2, get_computer_work(&me));
+    seL4_SetMR(3, (uint32_t)cycles);
+    seL4_SetMR(4, (uint32_t)(cycles >> 32));
+    return 5;
+}
+
+
+/*
+ * Entry point of the AI domain: serve requests forever.
+ */
+static void
+ai_domain_run() {
+    seL4_SetUserData(AI_DOMAIN_GAME);
+    for (;;) {
+        seL4_MessageInfo_t info = seL4_Wait(AI_PROCESS_ENDPOINT, NULL);
+        int len = 0;
+        if (seL4_MessageInfo_get_label(info) == AI_MOVE) {
+            len = serve_move();
+        }
+        seL4_Send(AI_PROCESS_REPLY, seL4_MessageInfo_new(0, 0, 0, len));
+    }
+}
+
+
+void
+ai_domain_poll() {
+    const uint64_t now = get_current_time();
+    if (now - lastPoll < POLL_NS) {
+        return;
+    }
+    lastPoll = now;
+    seL4_Send(AI_PROCESS_REPLY, seL4_MessageInfo_new(AI_POLL, 0, 0, 0));
+    seL4_Wait(AI_PROCESS_ENDPOINT, NULL);
+}
+
+
+/*
+ * Send a request (in the message registers) to the AI domain and wait for
+ * the reply (in the message registers); drain the keyboard whenever the
+ * AI domain asks to.
+ * @return: 0, or -1 if the AI domain has faulted instead of replying
+ */
+static int
+request(seL4_MessageInfo_t info) {
+    seL4_Word badge;
+    seL4_Send(endpoint.cptr, info);
+    for (;;) {
+        info = seL4_Wait(replyEndpoint.cptr, &badge);
+        if (badge != AI_PROCESS_REPLY_BADGE) {
+            break;
+        }
+        if (seL4_MessageInfo_get_label(info) != AI_POLL) {
+            return 0;
+        }
+        poll_during_search(UINT64_MAX);
+        seL4_Send(endpoint.cptr, seL4_MessageInfo_new(AI_POLL, 0, 0, 0));
+    }
+    assert(badge == AI_PROCESS_FAULT_BADGE);
+    if (seL4_MessageInfo_get_label(info) == seL4_VMFault) {
+        printf("AI domain: page fault at pc 0x%x, address 0x%x",
+                (unsigned)seL4_GetMR(0), (unsigned)seL4_GetMR(1));
+    } else {
+        printf("AI domain: fault of type %u",
+                (unsigned)seL4_MessageInfo_get_label(info));
+    }
+    printf("; the main thread decides the moves from now on\n");
+    ai_process_stop();
+    faulted = 1;
+    return -1;
+}
+
+
+void
+ai_domain_init(vka_t* vka, vspace_t* vspace, simple_t* simple) {
+    // the page the AI domain reads the players from, and the log: every
+    // cell is occupied once per round at most
+    assert(sizeof(shared_t) <= BIT(seL4_PageBits));
+    shared = alloc_pages(sizeof(shared_t));
+    const size_t logSize = numCellsX * numCellsY * sizeof(log_entry_t);
+    cellLog = alloc_pages(logSize);
+
+    // the board and the computer players of the AI domain: alloc_pages()
+    // maps their memory into the process as well
+    ai_process_create(vka, vspace, simple);
+    seL4_SetUserData(AI_DOMAIN_GAME);
+    board_init(numCellsX, numCellsY);
+    init_computer_move();
+    seL4_SetUserData(0);
+
+    // read-only views of the shared page and of the log
+    view = ai_process_share(shared, sizeof(shared_t));
+    viewLog = ai_process_share(cellLog, logSize);
+
+    UNUSED int err = vka_alloc_endpoint(vka, &endpoint);
+    assert(err == 0);
+    err = vka_alloc_endpoint(vka, &replyEndpoint);
+    assert(err == 0);
+    ai_process_start(ai_domain_run, endpoint.cptr, replyEndpoint.cptr);
+
+    uint64_t sum = 0;
+    nullRequest = ~0ULL;
+    for (int i = 0; i < NULL_CALLS; i++) {
+        const uint64_t t0 = read_tsc();
+        if (request(seL4_MessageInfo_new(AI_NULL, 0, 0, 0)) != 0) {
+            return;
+        }
+        const uint64_t t = read_tsc() - t0;
+        sum += t;
+        if (t < nullRequest) {
+            nullRequest = t;
+        }
+    }
+    printf("started AI domain; null request: %llu cycles (mean %llu)\n",
+            (unsigned long long)nullRequest,
+            (unsigned long long)(sum / NULL_CALLS));
+}
+
+
+static void
+log_cell(coord_t pos, cell_t entity) {
+    assert(shared->numCells < numCellsX * numCellsY);
+    cellLog[shared->numCells].pos = pos;
+    cellLog[shared->numCells].entity = entity;
+    shared->numCells++;
+}
+
+
+void
+ai_domain_newround(const player_t* players) {
+    shared->round++;
+    shared->numCells = 0;
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        log_cell(players[i].pos, players[i].entity);
+    }
+}
+
+
+void
+ai_domain_moved(const player_t* p) {
+    log_cell(p->pos, p->entity);
+}
+
+
+direction_t
+ai_domain_move(uint64_t endTime, player_t* me, player_t* you) {
+    const int pl = me->entity - CELL_P0;
+    if (!faulted) {
+        shared->players[pl] = *me;
+        shared->players[(pl + 1) % NUMPLAYERS] = *you;
+
+        seL4_SetMR(0, pl);
+        seL4_SetMR(1, (uint32_t)endTime);
+        seL4_SetMR(2, (uint32_t)(endTime >> 32));
+        seL4_SetMR(3, get_computer_level());
+        const uint64_t t0 = read_tsc();
+        if (request(seL4_MessageInfo_new(AI_MOVE, 0, 0, 4)) == 0) {
+            const uint64_t total = read_tsc() - t0;
+            const direction_t dir = seL4_GetMR(0);
+            me->rng = seL4_GetMR(1);
+            lastWork[pl] = seL4_GetMR(2);
+            uint64_t decision = seL4_GetMR(3) | (uint64_t)seL4_GetMR(4) << 32;
+            if (decision > total) {
+                // the cores' time stamp counters disagree
+                decision = total;
+            }
+            requests++;
+            decisionSum += total;
+            if (total > decisionMax) {
+                decisionMax = total;
+            }
+            ipcSum += total - decision;
+            if (total - decision > ipcMax) {
+                ipcMax = total - decision;
+            }
+            return dir;
+        }
+    }
+    // the AI domain has faulted; decide on the main thread's board
+    const direction_t dir = get_computer_move(endTime, me, you);
+    lastWork[pl] = get_computer_work(me);
+    return dir;
+}
+
+
+unsigned long
+ai_domain_work(const player_t* me) {
+    return lastWork[me->entity - CELL_P0];
+}
+
+
+void
+ai_domain_report() {
+    if (requests == 0) {
+        return;
+    }
+    printf("AI domain: %lu requests; time to decision %llu cycles "
+            "(max %llu), of which IPC %llu (max %llu; null request %llu)\n",
+            requests, (unsigned long long)(decisionSum / requests),
+            (unsigned long long)decisionMax,
+            (unsigned long long)(ipcSum / requests),
+            (unsigned long long)ipcMax, (unsigned long long)nullRequest);
+    requests = 0;
+    decisionSum = decisionMax = ipcSum = ipcMax = 0;
+}
+
+#endif /* CONFIG_APP_TRON_AI_DOMAIN */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef AIDOMAIN_H_
+#define AIDOMAIN_H_
+
+#include <vka/vka.h>
+#include <vspace/vspace.h>
+#include <simple/simple.h>
+#include "tron.h"
+
+/*
+ * Set up and start the AI domain, and measure the cost of a request it
+ * does nothing for. Call after board_init() of game 0.
+ */
+void ai_domain_init(vka_t* vka, vspace_t* vspace, simple_t* simple);
+
+/*
+ * Tell the AI domain that a round starts with the players at their start
+ * cells, or that player p has moved to a new cell (p->pos). Every cell
+ * the players occupy has to be passed on, one way or the other.
+ */
+void ai_domain_newround(const player_t* players);
+void ai_domain_moved(const player_t* p);
+
+/*
+ * Like get_computer_move() and get_computer_work(), but the move is
+ * computed by the AI domain (or, once it has faulted, by the main thread).
+ */
+direction_t ai_domain_move(uint64_t endTime, player_t* me, player_t* you);
+unsigned long ai_domain_work(const player_t* me);
+
+/*
+ * Called by poll_during_search() in the AI domain: every now and then, let
+ * the main thread, which waits for the move, drain the keyboard.
+ */
+void ai_domain_poll();
+
+/*
+ * Print what the requests since the last call cost, per request: the
+ * time to decision and the IPC round trip on top of it.
+ */
+void ai_domain_report();
+
+
+#endif /* AIDOMAIN_H_ */
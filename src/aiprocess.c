@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * The process of the AI domain (see aidomain.c): a thread with a VSpace
+ * and a CSpace of its own.
+ *
+ * The app builds a single image, so the process runs a copy of the root
+ * task's image rather than an ELF file of its own. Its VSpace maps the
+ * image at the root task's addresses:
+ *
+ *   - the code (up to etext) is the root task's, mapped read-only;
+ *   - of the archive, only the opening book is mapped (read-only), which
+ *     the computer player reads from there; the rest (the images) is
+ *     left unmapped;
+ *   - all other pages of the image (data, bss, and with them the heap)
+ *     are copies, taken when the process starts.
+ *
+ * Besides, the process gets the memory the main thread allocates for it
+ * (see ai_process_map()) and read-only views of the main thread's memory
+ * (see ai_process_share()). It cannot allocate memory itself. Its CSpace
+ * is a CNode with the two endpoints of aidomain.c in it, and the reply
+ * endpoint once more as the fault endpoint of its thread; nothing else.
+ *
+ * The main thread keeps its mappings of the memory of the process (to
+ * copy the data into it); the process has no mapping of the main
+ * thread's memory but the read-only ones.
+ */
+
+#include <autoconf.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sel4/sel4.h>
+#include <sel4utils/thread.h>
+#include <sel4utils/vspace.h>
+#include <vka/object.h>
+#include <vka/capops.h>
+#include <cpio/cpio.h>
+#include "aiprocess.h"
+
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+
+/* the CNode of the process has 1 << CNODE_BITS slots: the endpoints (see
+ * aiprocess.h), and the reply endpoint as fault endpoint */
+#define CNODE_BITS 2
+#define FAULT 3
+
+#define PAGE BIT(seL4_PageBits)
+
+/* runs of the image with pages copied into the process */
+#define MAX_COPIES 8
+
+/* what a page of the image is in the process */
+enum { PAGE_CODE, PAGE_BOOK, PAGE_COPY, PAGE_NONE };
+
+/* start and end of the code (see the linker's default script), and the
+ * archive (see main.c) */
+extern char __executable_start[];
+extern char etext[];
+extern char _cpio_archive[];
+
+static vka_t* vka;
+static vspace_t* vspace;
+static simple_t* simple;
+static vspace_t process;
+static sel4utils_alloc_data_t processData;
+static vka_object_t pageDirectory;
+static vka_object_t cnode;
+static sel4utils_thread_t thread;
+
+/* the image, the part of it the archive takes, and the opening book */
+static char* imageStart;
+static char* imageEnd;
+static char* archiveEnd;
+static const char* bookStart;
+static const char* bookEnd;
+
+/* the pages copied into the process, and the main thread's mapping of
+ * the copies */
+static struct {
+    char* vaddr;
+    char* copy;
+    size_t size;
+} copies[MAX_COPIES];
+static int numCopies = 0;
+
+
+/*
+ * Copy capability "cap" into a new slot of the main thread's CSpace.
+ * @return: the copy
+ */
+static seL4_CPtr
+copy_cap(seL4_CPtr cap) {
+    seL4_CPtr copy;
+    UNUSED int err = vka_cspace_alloc(vka, &copy);
+    assert(err == 0);
+    cspacepath_t src, dest;
+    vka_cspace_make_path(vka, cap, &src);
+    vka_cspace_make_path(vka, copy, &dest);
+    err = vka_cnode_copy(&dest, &src, seL4_AllRights);
+    assert(err == 0);
+    return copy;
+}
+
+
+/*
+ * What page "page" of the image is in the process.
+ */
+static int
+page_kind(const char* page) {
+    if (page < (char*)ROUND_UP((uintptr_t)etext, seL4_PageBits)) {
+        return PAGE_CODE;
+    }
+    if (page < _cpio_archive || page + PAGE > archiveEnd) {
+        // (partly) outside the archive
+        return PAGE_COPY;
+    }
+    return page < bookEnd && page + PAGE > bookStart ? PAGE_BOOK : PAGE_NONE;
+}
+
+
+/*
+ * Map the "numPages" pages of the image at "vaddr", all of kind "kind",
+ * into the process.
+ */
+static void
+map_image(char* vaddr, size_t numPages, int kind) {
+    const seL4_CapRights rights = kind == PAGE_COPY ? seL4_AllRights
+            : seL4_CanRead;
+    reservation_t res = vspace_reserve_range_at(&process, vaddr,
+            numPages * PAGE, rights, 1);
+    assert(res.res != NULL);
+    if (kind == PAGE_NONE) {
+        // reserved, so that the process faults on it
+        return;
+    }
+    char* copy = NULL;
+    if (kind == PAGE_COPY) {
+        assert(numCopies < MAX_COPIES);
+        copy = vspace_new_pages(vspace, seL4_AllRights, numPages,
+                seL4_PageBits);
+        assert(copy != NULL);
+        copies[numCopies].vaddr = vaddr;
+        copies[numCopies].copy = copy;
+        copies[numCopies].size = numPages * PAGE;
+        numCopies++;
+    }
+    const seL4_CPtr frames = seL4_GetBootInfo()->userImageFrames.start;
+    for (size_t i = 0; i < numPages; i++) {
+        char* page = vaddr + i * PAGE;
+        seL4_CPtr cap = copy != NULL ? vspace_get_cap(vspace, copy + i * PAGE)
+                : frames + (page - imageStart) / PAGE;
+        cap = copy_cap(cap);
+        UNUSED int err = vspace_map_pages_at_vaddr(&process, &cap, NULL,
+                page, 1, seL4_PageBits, res);
+        assert(err == 0);
+    }
+}
+
+
+void
+ai_process_create(vka_t* v, vspace_t* vs, simple_t* s) {
+    vka = v;
+    vspace = vs;
+    simple = s;
+    UNUSED int err = vka_alloc_page_directory(vka, &pageDirectory);
+    assert(err == 0);
+    err = seL4_IA32_ASIDPool_Assign(seL4_CapInitThreadASIDPool,
+            pageDirectory.cptr);
+    assert(err == 0);
+    err = sel4utils_get_vspace(vspace, &process, &processData, vka,
+            pageDirectory.cptr, NULL, NULL);
+    assert(err == 0);
+
+    // where the image, the archive, and the book are
+    const seL4_SlotRegion frames = seL4_GetBootInfo()->userImageFrames;
+    imageStart = (char*)((uintptr_t)__executable_start & ~(PAGE - 1));
+    imageEnd = imageStart + (frames.end - frames.start) * PAGE;
+    archiveEnd = _cpio_archive;
+    const char* name;
+    unsigned long size;
+    const char* file;
+    for (int i = 0; (file = cpio_get_entry(_cpio_archive, i, &name, &size))
+            != NULL; i++) {
+        if (file + size > archiveEnd) {
+            archiveEnd = (char*)file + size;
+        }
+    }
+    bookStart = cpio_get_file(_cpio_archive, "book.bin", &size);
+    bookEnd = bookStart != NULL ? bookStart + size : NULL;
+
+    // map the image in runs of pages of the same kind
+    char* run = imageStart;
+    for (char* page = imageStart; page <= imageEnd; page += PAGE) {
+        if (page == imageEnd || page_kind(page) != page_kind(run)) {
+            map_image(run, (page - run) / PAGE, page_kind(run));
+            run = page;
+        }
+    }
+}
+
+
+void
+ai_process_map(void* vaddr, size_t numPages) {
+    reservation_t res = vspace_reserve_range_at(&process, vaddr,
+            numPages * PAGE, seL4_AllRights, 1);
+    assert(res.res != NULL);
+    for (size_t i = 0; i < numPages; i++) {
+        char* page = (char*)vaddr + i * PAGE;
+        seL4_CPtr cap = copy_cap(vspace_get_cap(vspace, page));
+        UNUSED int err = vspace_map_pages_at_vaddr(&process, &cap, NULL,
+                page, 1, seL4_PageBits, res);
+        assert(err == 0);
+    }
+}
+
+
+const void*
+ai_process_share(const void* vaddr, size_t size) {
+    const void* view = vspace_share_mem(vspace, &process, (void*)vaddr,
+            ROUND_UP(size, seL4_PageBits) >> seL4_PageBits, seL4_PageBits,
+            seL4_CanRead, 1);
+    assert(view != NULL);
+    return view;
+}
+
+
+void
+ai_process_start(void (*entry)(void), seL4_CPtr endpoint,
+        seL4_CPtr replyEndpoint) {
+    // a CSpace with nothing in it but the endpoints: receive requests from
+    // the one, send replies (and faults) to the other; the badges tell
+    // replies and faults apart
+    UNUSED int err = vka_alloc_cnode_object(vka, CNODE_BITS, &cnode);
+    assert(err == 0);
+    const seL4_CPtr root = simple_get_cnode(simple);
+    err = seL4_CNode_Copy(cnode.cptr, AI_PROCESS_ENDPOINT, CNODE_BITS, root,
+            endpoint, seL4_WordBits, seL4_CanRead);
+    assert(err == 0);
+    err = seL4_CNode_Mint(cnode.cptr, AI_PROCESS_REPLY, CNODE_BITS, root,
+            replyEndpoint, seL4_WordBits, seL4_CanWrite,
+            seL4_CapData_Badge_new(AI_PROCESS_REPLY_BADGE));
+    assert(err == 0);
+    // the kernel sends faults like an seL4_Call(), which needs the grant
+    // right; the fault endpoint is looked up in the thread's CSpace
+    err = seL4_CNode_Mint(cnode.cptr, FAULT, CNODE_BITS, root,
+            replyEndpoint, seL4_WordBits, seL4_CanWrite | seL4_CanGrant,
+            seL4_CapData_Badge_new(AI_PROCESS_FAULT_BADGE));
+    assert(err == 0);
+
+    // on the main thread's core: the main thread waits for every reply;
+    // the stack and the IPC buffer are in the process
+    err = sel4utils_configure_thread(vka, vspace, &process, FAULT,
+            seL4_MaxPrio, cnode.cptr,
+            seL4_CapData_Guard_new(0, seL4_WordBits - CNODE_BITS), &thread);
+    assert(err == 0);
+
+    // the data of the process: the main thread's, as it is now
+    for (int i = 0; i < numCopies; i++) {
+        memcpy(copies[i].copy, copies[i].vaddr, copies[i].size);
+    }
+
+    // sel4utils_start_thread() would write the arguments of "entry" onto
+    // the stack through the main thread's VSpace; "entry" takes none
+    seL4_UserContext context;
+    memset(&context, 0, sizeof(context));
+    context.eip = (seL4_Word)entry;
+    // as if "entry" had been called: a return address on the stack
+    context.esp = (seL4_Word)thread.stack_top - sizeof(seL4_Word);
+    context.gs = IPCBUF_GDT_SELECTOR;
+    err = seL4_TCB_WriteRegisters(thread.tcb.cptr, 1, 0,
+            sizeof(context) / sizeof(seL4_Word), &context);
+    assert(err == 0);
+}
+
+
+void
+ai_process_stop() {
+    seL4_TCB_Suspend(thread.tcb.cptr);
+}
+
+#endif /* CONFIG_APP_TRON_AI_DOMAIN */
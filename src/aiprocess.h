@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef AIPROCESS_H_
+#define AIPROCESS_H_
+
+#include <stddef.h>
+#include <sel4/sel4.h>
+#include <vka/vka.h>
+#include <vspace/vspace.h>
+#include <simple/simple.h>
+
+/* the capabilities in the CSpace of the process: the endpoint it receives
+ * requests from, and the endpoint it sends its replies to */
+#define AI_PROCESS_ENDPOINT 1
+#define AI_PROCESS_REPLY 2
+
+/* badges of what arrives on the reply endpoint: a message of the process,
+ * or a fault of its thread */
+enum { AI_PROCESS_REPLY_BADGE = 1, AI_PROCESS_FAULT_BADGE };
+
+/*
+ * Create the VSpace of the process, with the image mapped into it (see
+ * aiprocess.c). Call once, before the other functions.
+ */
+void ai_process_create(vka_t* vka, vspace_t* vspace, simple_t* simple);
+
+/*
+ * Map the "numPages" pages the main thread has allocated at "vaddr" into
+ * the process, at the same address (read-write).
+ */
+void ai_process_map(void* vaddr, size_t numPages);
+
+/*
+ * Map the "size" bytes of memory at "vaddr" (page aligned) into the
+ * process, read-only.
+ * @return: the address of the memory in the process
+ */
+const void* ai_process_share(const void* vaddr, size_t size);
+
+/*
+ * Start the process at "entry", with "endpoint" and "replyEndpoint" in its
+ * CSpace; the reply endpoint also receives the faults of its thread. The
+ * process gets a copy of the main thread's data as it is now.
+ */
+void ai_process_start(void (*entry)(void), seL4_CPtr endpoint,
+        seL4_CPtr replyEndpoint);
+
+/*
+ * Stop the process for good (after it has faulted).
+ */
+void ai_process_stop();
+
+
+#endif /* AIPROCESS_H_ */
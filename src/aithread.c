@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Every computer player gets its own thread. In each tick, the main thread
+ * sends a request to both AI threads and waits for both answers; both
+ * threads search the same board, so neither move depends on the other.
+ *
+ * The kernel this app is built against runs on a single core and has no
+ * way to pin a thread to a core: the AI threads time-share the core with
+ * each other and the main thread, so they do not search faster than one
+ * thread would (at level "timed", each gets about half of the tick).
+ *
+ * Requests and answers are passed through async endpoints (notifications);
+ * the arguments and results are in the static variables below, which the
+ * main thread only touches while the AI threads are idle.
+ */
+
+#include <autoconf.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sel4/sel4.h>
+#include <sel4utils/thread.h>
+#include <vka/object.h>
+#include "aithread.h"
+#include "memstat.h"
+
+typedef struct {
+    sel4utils_thread_t thread;
+    /* the main thread signals a new request */
+    vka_object_t request;
+    /* the AI thread signals that it is done */
+    vka_object_t done;
+    /* arguments and result of get_computer_move() */
+    uint64_t endTime;
+    player_t* me;
+    player_t* you;
+    direction_t result;
+} ai_thread_t;
+
+static ai_thread_t threads[NUMPLAYERS];
+
+
+/*
+ * Entry point of an AI thread: serve requests forever.
+ */
+static void
+ai_thread_run(void* arg0, UNUSED void* arg1, UNUSED void* ipc_buf) {
+    ai_thread_t* t = arg0;
+    for (;;) {
+        seL4_Wait(t->request.cptr, NULL);
+        t->result = get_computer_move(t->endTime, t->me, t->you);
+        seL4_Notify(t->done.cptr, 1);
+    }
+}
+
+
+/*
+ * Create and start one AI thread per player.
+ */
+void
+ai_threads_init(vka_t* vka, vspace_t* vspace, simple_t* simple) {
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        ai_thread_t* t = &threads[i];
+        UNUSED int err = vka_alloc_async_endpoint(vka, &t->request);
+        assert(err == 0);
+        err = vka_alloc_async_endpoint(vka, &t->done);
+        assert(err == 0);
+
+        err = sel4utils_configure_thread(vka, vspace, vspace, seL4_CapNull,
+                seL4_MaxPrio, simple_get_cnode(simple), seL4_NilData,
+                &t->thread);
+        assert(err == 0);
+        memstat_add_stack(i == 0 ? "AI thread 0" : "AI thread 1",
+                t->thread.stack_top);
+        err = sel4utils_start_thread(&t->thread, ai_thread_run, t, NULL, 1);
+        assert(err == 0);
+    }
+    printf("started %d AI threads\n", NUMPLAYERS);
+}
+
+
+/*
+ * Compute the next move of both (computer) players, each on its thread,
+ * based on the current state of the board and players, and set their
+ * directions.
+ * @param endTime: time both players have to decide on a move
+ */
+void
+ai_threads_move(uint64_t endTime, player_t* players) {
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        ai_thread_t* t = &threads[i];
+        t->endTime = endTime;
+        t->me = players + i;
+        t->you = players + (i + 1) % NUMPLAYERS;
+        seL4_Notify(t->request.cptr, 1);
+    }
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        seL4_Wait(threads[i].done.cptr, NULL);
+    }
+    // the threads are idle now, so we may change the players
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        players[i].direction = threads[i].result;
+    }
+}
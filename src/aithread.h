@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef AITHREAD_H_
+#define AITHREAD_H_
+
+#include <vka/vka.h>
+#include <vspace/vspace.h>
+#include <simple/simple.h>
+#include "tron.h"
+
+void ai_threads_init(vka_t* vka, vspace_t* vspace, simple_t* simple);
+void ai_threads_move(uint64_t endTime, player_t* players);
+
+
+#endif /* AITHREAD_H_ */
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * A simple "bump" (arena) allocator. Memory is handed out by advancing a
+ * pointer and is never freed individually; instead the whole arena is reset
+ * at once. The game AI uses it for all its per-move data, so that the search
+ * never calls malloc() and its memory use is bounded and easy to report.
+ */
+#include <assert.h>
+#include "arena.h"
+
+/* alignment of all allocations (bytes) */
+#define ARENA_ALIGN 8
+
+
+/*
+ * Initialize arena "a" to hand out the "size" bytes at "mem".
+ */
+void
+arena_init(arena_t* a, void* mem, size_t size) {
+    assert(mem != NULL);
+    a->base = mem;
+    a->size = size;
+    a->used = 0;
+    a->highwater = 0;
+}
+
+
+/*
+ * Allocate "size" bytes from arena "a".
+ * @return: pointer to memory; NULL if the arena is exhausted
+ */
+void*
+arena_alloc(arena_t* a, size_t size) {
+    size_t start = (a->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (start + size > a->size) {
+        return NULL;
+    }
+    a->used = start + size;
+    if (a->used > a->highwater) {
+        a->highwater = a->used;
+    }
+    return a->base + start;
+}
+
+
+/*
+ * Release all memory allocated from arena "a" at once.
+ */
+void
+arena_reset(arena_t* a) {
+    a->used = 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+
+typedef struct {
+    /* start of the memory handed out by the arena */
+    char* base;
+    /* size of the memory at base (bytes) */
+    size_t size;
+    /* number of bytes allocated since the last reset */
+    size_t used;
+    /* largest value "used" ever had */
+    size_t highwater;
+} arena_t;
+
+void arena_init(arena_t* a, void* mem, size_t size);
+void* arena_alloc(arena_t* a, size_t size);
+void arena_reset(arena_t* a);
+
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,803 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * The game board, plus a structure that keeps track of the connected
+ * regions of empty cells: every empty cell has a region label, and every
+ * label has a size. This is kept up to date by put_board(), so that the
+ * size of the region a cell is in, and whether two cells are in the same
+ * region, are answered in constant time.
+ *
+ * Filling a cell can split its region. Most of the time, a look at the 8
+ * cells around the filled cell shows that this is impossible. Otherwise
+ * we run one breadth-first search per part the region may have split
+ * into, all in lockstep. When searches meet, their parts are connected.
+ * When all searches of a part are done without meeting the others, the
+ * part is a new region and gets a new label. We stop as soon as only one
+ * part is left, so the cost is proportional to the size of the smaller
+ * parts, not to the size of the region.
+ *
+ * Emptying a cell (which the game itself does not do; see board_reset())
+ * merges the regions around it by relabeling the smaller ones.
+ *
+ * The board also keeps a coarse summary of itself, the occupancy pyramid:
+ * for square blocks of 8x8 cells (level 0) and 32x32 cells (level 1), the
+ * number of empty cells in the block, and the number of pairs of empty
+ * cells across each edge between two neighboring blocks ("openness").
+ * A path of empty cells from one block to another must cross open edges,
+ * so searches on the blocks give cheap bounds on the reachable area far
+ * away from a player.
+ *
+ * Moves of the players are applied with move_apply(), which remembers what
+ * it changed (the player's position and direction, and the cell the
+ * player moves to) on an undo stack, so move_undo() can take the last
+ * moves back in place. Searches that look ahead apply and undo moves on
+ * the board itself instead of copying it; all derived state (regions,
+ * pyramid, hash) follows along through put_board(). There is one board
+ * per game (see get_game() in tron.h); whoever applies moves on it must
+ * have it to itself.
+ *
+ * The board does not depend on seL4, so it is shared with the host tools.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include "board.h"
+
+/* board geometry; see tron.h */
+int numCellsX;
+int numCellsY;
+
+/* maximum number of parts a region can split into (one per neighbor) */
+#define MAX_PARTS 4
+
+/* one level of the occupancy pyramid */
+typedef struct {
+    /* size of the board in blocks */
+    int w;
+    int h;
+    /* number of empty cells of each block */
+    int* empty;
+    /* number of pairs of empty cells across the east (south) edge of each
+     * block, i.e. with the block to the right (below) */
+    int* openE;
+    int* openS;
+} level_t;
+
+/* one move on the undo stack */
+typedef struct {
+    player_t* p;
+    /* player's position and direction before the move */
+    coord_t pos;
+    direction_t dir;
+    /* the cell the player moved to, before the move (the board is not
+     * changed if that cell was not empty) */
+    cell_t cell;
+} undo_t;
+
+/* the board of one game, with everything derived from it */
+typedef struct {
+    /* the board is made of cells; cell coordinate (0,0) is in top left
+     * corner; cell (x,y) is stored at board[y * numCellsX + x] */
+    cell_t* board;
+
+    /* number of cells the arrays below have room for */
+    int capacity;
+
+    /* region label of each cell; 0 for cells that are not empty */
+    int* label;
+
+    /* size of each region (indexed by label); labels are not reused until
+     * they run out, then all regions are relabeled */
+    int* size;
+    int nextLabel;
+    int maxLabels;
+
+    /* number of cells visited so far to keep the regions up to date: the
+     * cost behind region_size() */
+    unsigned long upkeep;
+
+    /* for the searches: the cell after each cell in a search's queue, and
+     * the search (mark - markBase) that visited each cell */
+    int* qnext;
+    uint32_t* mark;
+    uint32_t markBase;
+
+    /* offsets of the 4 neighbors of a cell (in cells) */
+    int nb[4];
+
+    level_t levels[BLOCK_LEVELS];
+
+    /* copies of the board, the labels, and the pyramid of the empty board
+     * (walls around the border), so board_reset() only has to copy them */
+    cell_t* emptyBoard;
+    int* emptyLabel;
+    level_t emptyLevels[BLOCK_LEVELS];
+    uint64_t emptyHash;
+
+    /* Zobrist hash of the board: the xor of the keys of all cells that
+     * are not empty */
+    uint64_t hash;
+
+    /* The undo stack is a ring buffer: after more than UNDO_LEN moves the
+     * oldest moves are forgotten. */
+    undo_t undoStack[UNDO_LEN];
+    int undoTop;
+    int undoDepth;
+
+    /* number of blocks the arrays of level 0 have room for */
+    int blockCapacity;
+} board_state_t;
+
+/* the board of each game (see get_game()) */
+static board_state_t boardStates[MAX_GAMES];
+
+
+static inline int
+isempty_element(cell_t e) {
+    return e != CELL_P0 && e != CELL_P1 && e != CELL_WALL;
+}
+
+
+static inline int
+isempty(int c) {
+    board_state_t* bs = &boardStates[get_game()];
+    return isempty_element(bs->board[c]);
+}
+
+
+/*
+ * Get a new, unique value to mark the cells visited by up to MAX_PARTS
+ * searches with.
+ */
+static uint32_t
+new_markBase() {
+    board_state_t* bs = &boardStates[get_game()];
+    bs->markBase += MAX_PARTS;
+    if (bs->markBase == 0 || bs->markBase + MAX_PARTS < bs->markBase) {
+        // wrapped around; start over
+        memset(bs->mark, 0, bs->capacity * sizeof(uint32_t));
+        bs->markBase = MAX_PARTS;
+    }
+    return bs->markBase;
+}
+
+
+/*
+ * Give all cells of the region containing empty cell "start" label "l";
+ * cells that already have label "l" are not entered.
+ * @return: number of cells labeled
+ */
+static int
+flood_label(int start, int l) {
+    board_state_t* bs = &boardStates[get_game()];
+    uint32_t m = new_markBase();
+    int head = start;
+    int tail = start;
+    int n = 1;
+    bs->mark[start] = m;
+    bs->qnext[start] = -1;
+    while (head >= 0) {
+        bs->upkeep++;
+        bs->label[head] = l;
+        for (int i = 0; i < 4; i++) {
+            int c = head + bs->nb[i];
+            if (isempty(c) && bs->mark[c] != m && bs->label[c] != l) {
+                bs->mark[c] = m;
+                bs->qnext[c] = -1;
+                bs->qnext[tail] = c;
+                tail = c;
+                n++;
+            }
+        }
+        head = bs->qnext[head];
+    }
+    return n;
+}
+
+
+/*
+ * Label all regions again, starting from label 1.
+ */
+static void
+relabel() {
+    board_state_t* bs = &boardStates[get_game()];
+    for (int c = 0; c < numCellsX * numCellsY; c++) {
+        bs->label[c] = 0;
+    }
+    bs->nextLabel = 1;
+    for (int c = 0; c < numCellsX * numCellsY; c++) {
+        if (isempty(c) && bs->label[c] == 0) {
+            assert(bs->nextLabel < bs->maxLabels);
+            bs->size[bs->nextLabel] = flood_label(c, bs->nextLabel);
+            bs->nextLabel++;
+        }
+    }
+}
+
+
+/*
+ * Update the occupancy pyramid for cell c, which was emptied (delta 1) or
+ * filled (delta -1).
+ */
+static void
+pyramid_update(int c, int delta) {
+    board_state_t* bs = &boardStates[get_game()];
+    int x = c % numCellsX;
+    int y = c / numCellsX;
+    for (int l = 0; l < BLOCK_LEVELS; l++) {
+        level_t* lv = &bs->levels[l];
+        int mask = (1 << BLOCK_SHIFT(l)) - 1;
+        int b = (y >> BLOCK_SHIFT(l)) * lv->w + (x >> BLOCK_SHIFT(l));
+        lv->empty[b] += delta;
+        // pairs with the cells on the other side of the block's edges
+        if ((x & mask) == mask && x + 1 < numCellsX && isempty(c + 1)) {
+            lv->openE[b] += delta;
+        }
+        if ((x & mask) == 0 && x > 0 && isempty(c - 1)) {
+            lv->openE[b - 1] += delta;
+        }
+        if ((y & mask) == mask && y + 1 < numCellsY && isempty(c + numCellsX)) {
+            lv->openS[b] += delta;
+        }
+        if ((y & mask) == 0 && y > 0 && isempty(c - numCellsX)) {
+            lv->openS[b - lv->w] += delta;
+        }
+    }
+}
+
+
+/*
+ * Build the occupancy pyramid from scratch.
+ */
+static void
+pyramid_rebuild() {
+    board_state_t* bs = &boardStates[get_game()];
+    for (int l = 0; l < BLOCK_LEVELS; l++) {
+        level_t* lv = &bs->levels[l];
+        memset(lv->empty, 0, lv->w * lv->h * sizeof(int));
+        memset(lv->openE, 0, lv->w * lv->h * sizeof(int));
+        memset(lv->openS, 0, lv->w * lv->h * sizeof(int));
+    }
+    for (int c = 0; c < numCellsX * numCellsY; c++) {
+        if (isempty(c)) {
+            // pairs are counted when their second cell is added
+            int x = c % numCellsX;
+            int y = c / numCellsX;
+            for (int l = 0; l < BLOCK_LEVELS; l++) {
+                level_t* lv = &bs->levels[l];
+                int mask = (1 << BLOCK_SHIFT(l)) - 1;
+                int b = (y >> BLOCK_SHIFT(l)) * lv->w + (x >> BLOCK_SHIFT(l));
+                lv->empty[b]++;
+                if ((x & mask) == 0 && x > 0 && isempty(c - 1)) {
+                    lv->openE[b - 1]++;
+                }
+                if ((y & mask) == 0 && y > 0 && isempty(c - numCellsX)) {
+                    lv->openS[b - lv->w]++;
+                }
+            }
+        }
+    }
+}
+
+
+/*
+ * Key of cell c holding element e for the Zobrist hash. The keys are
+ * computed instead of stored in a table, which would need a random number
+ * for every cell and element. (splitmix64 finalizer)
+ */
+static inline uint64_t
+hash_key(int c, cell_t e) {
+    uint64_t z = (uint64_t)c * CELL_LEN + e + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+
+/*
+ * Build the empty board (walls around the border, all other cells empty)
+ * with all derived state from scratch, and keep a copy for board_reset().
+ */
+static void
+build_emptyBoard() {
+    board_state_t* bs = &boardStates[get_game()];
+    for (int y = 0; y < numCellsY; y++) {
+        for (int x = 0; x < numCellsX; x++) {
+            int border = x == 0 || x == numCellsX - 1
+                      || y == 0 || y == numCellsY - 1;
+            bs->board[y * numCellsX + x] = border ? CELL_WALL : CELL_EMPTY;
+            bs->label[y * numCellsX + x] = border ? 0 : 1;
+        }
+    }
+    pyramid_rebuild();
+    bs->emptyHash = 0;
+    for (int c = 0; c < numCellsX * numCellsY; c++) {
+        if (bs->board[c] != CELL_EMPTY) {
+            bs->emptyHash ^= hash_key(c, bs->board[c]);
+        }
+    }
+
+    int numCells = numCellsX * numCellsY;
+    memcpy(bs->emptyBoard, bs->board, numCells * sizeof(cell_t));
+    memcpy(bs->emptyLabel, bs->label, numCells * sizeof(int));
+    for (int l = 0; l < BLOCK_LEVELS; l++) {
+        int n = block_count(l) * sizeof(int);
+        memcpy(bs->emptyLevels[l].empty, bs->levels[l].empty, n);
+        memcpy(bs->emptyLevels[l].openE, bs->levels[l].openE, n);
+        memcpy(bs->emptyLevels[l].openS, bs->levels[l].openS, n);
+    }
+}
+
+
+/*
+ * Clear the board: walls around the border, all other cells empty.
+ * This copies the empty board kept by build_emptyBoard().
+ */
+void
+board_reset() {
+    board_state_t* bs = &boardStates[get_game()];
+    int numCells = numCellsX * numCellsY;
+    memcpy(bs->board, bs->emptyBoard, numCells * sizeof(cell_t));
+    memcpy(bs->label, bs->emptyLabel, numCells * sizeof(int));
+    for (int l = 0; l < BLOCK_LEVELS; l++) {
+        int n = block_count(l) * sizeof(int);
+        memcpy(bs->levels[l].empty, bs->emptyLevels[l].empty, n);
+        memcpy(bs->levels[l].openE, bs->emptyLevels[l].openE, n);
+        memcpy(bs->levels[l].openS, bs->emptyLevels[l].openS, n);
+    }
+    // all empty cells are in region 1
+    bs->nextLabel = 2;
+    bs->size[0] = 0;
+    bs->size[1] = (numCellsX - 2) * (numCellsY - 2);
+    bs->hash = bs->emptyHash;
+    bs->undoTop = bs->undoDepth = 0;
+}
+
+
+/*
+ * Set the board dimensions and clear the board.
+ */
+void
+board_init(int x, int y) {
+    board_state_t* bs = &boardStates[get_game()];
+    if (x * y > bs->capacity) {
+        bs->capacity = x * y;
+        bs->board = alloc_pages(bs->capacity * sizeof(cell_t));
+        bs->label = alloc_pages(bs->capacity * sizeof(int));
+        bs->emptyBoard = alloc_pages(bs->capacity * sizeof(cell_t));
+        bs->emptyLabel = alloc_pages(bs->capacity * sizeof(int));
+        bs->maxLabels = bs->capacity + 2;
+        bs->size = alloc_pages(bs->maxLabels * sizeof(int));
+        bs->qnext = alloc_pages(bs->capacity * sizeof(int));
+        bs->mark = alloc_pages(bs->capacity * sizeof(uint32_t));
+    }
+    for (int l = 0; l < BLOCK_LEVELS; l++) {
+        level_t* lv = &bs->levels[l];
+        lv->w = (x + (1 << BLOCK_SHIFT(l)) - 1) >> BLOCK_SHIFT(l);
+        lv->h = (y + (1 << BLOCK_SHIFT(l)) - 1) >> BLOCK_SHIFT(l);
+    }
+    // higher levels have fewer blocks than level 0
+    if (bs->levels[0].w * bs->levels[0].h > bs->blockCapacity) {
+        bs->blockCapacity = bs->levels[0].w * bs->levels[0].h;
+        size_t n = bs->blockCapacity * sizeof(int);
+        for (int l = 0; l < BLOCK_LEVELS; l++) {
+            bs->levels[l].empty = alloc_pages(n);
+            bs->levels[l].openE = alloc_pages(n);
+            bs->levels[l].openS = alloc_pages(n);
+            bs->emptyLevels[l].empty = alloc_pages(n);
+            bs->emptyLevels[l].openE = alloc_pages(n);
+            bs->emptyLevels[l].openS = alloc_pages(n);
+        }
+    }
+    numCellsX = x;
+    numCellsY = y;
+    bs->nb[0] = -1;
+    bs->nb[1] = -x;
+    bs->nb[2] = 1;
+    bs->nb[3] = x;
+    build_emptyBoard();
+    board_reset();
+}
+
+
+/*
+ * Zobrist hash of the board: boards with the same cells have the same
+ * hash; a different board has a different hash with high probability.
+ */
+uint64_t
+board_hash() {
+    board_state_t* bs = &boardStates[get_game()];
+    return bs->hash;
+}
+
+
+/*
+ * Check the 8 cells around filled cell c: find the groups of empty
+ * neighbors (left, up, right, down) that are connected through these 8
+ * cells.
+ * @param reps: returns one neighbor per group
+ * @return: number of groups
+ */
+static int
+local_groups(int c, int reps[MAX_PARTS]) {
+    board_state_t* bs = &boardStates[get_game()];
+    // neighbors and the diagonal cell between neighbor i and i+1
+    int x = numCellsX;
+    int diag[4] = {c - x - 1, c - x + 1, c + x + 1, c + x - 1};
+    int n = 0;
+    int first = -1;
+    int prev = 0; // previous neighbor (in ring order) is in current group
+    for (int i = 0; i < 4; i++) {
+        int e = isempty(c + bs->nb[i]);
+        if (e && !prev) {
+            reps[n++] = c + bs->nb[i];
+            if (i == 0) {
+                first = 0;
+            }
+        }
+        prev = e && isempty(diag[i]);
+    }
+    // the last group may wrap around to the first neighbor
+    if (n > 1 && first == 0 && prev) {
+        n--;
+    }
+    return n;
+}
+
+
+/*
+ * Cell c (with label l) was filled: update the regions.
+ */
+static void
+region_fill(int c) {
+    board_state_t* bs = &boardStates[get_game()];
+    int l = bs->label[c];
+    bs->label[c] = 0;
+    bs->size[l]--;
+
+    int reps[MAX_PARTS];
+    int numParts = local_groups(c, reps);
+    if (numParts <= 1) {
+        return;
+    }
+
+    // one search per part; searches of parts found to be connected are
+    // in the same group (group[i] is the lowest search index of the group)
+    uint32_t m = new_markBase();
+    int head[MAX_PARTS];
+    int tail[MAX_PARTS];
+    int count[MAX_PARTS];
+    int group[MAX_PARTS];
+    for (int i = 0; i < numParts; i++) {
+        head[i] = tail[i] = reps[i];
+        bs->qnext[reps[i]] = -1;
+        bs->mark[reps[i]] = m + i;
+        count[i] = 1;
+        group[i] = i;
+    }
+
+    int numGroups = numParts;
+    while (numGroups > 1) {
+        for (int i = 0; i < numParts && numGroups > 1; i++) {
+            if (group[i] < 0 || head[i] < 0) {
+                // part was split off already, or search is done
+                continue;
+            }
+            int h = head[i];
+            bs->upkeep++;
+            for (int k = 0; k < 4; k++) {
+                int n = h + bs->nb[k];
+                if (!isempty(n)) {
+                    continue;
+                }
+                if (bs->mark[n] < m || bs->mark[n] >= m + MAX_PARTS) {
+                    bs->mark[n] = m + i;
+                    bs->qnext[n] = -1;
+                    bs->qnext[tail[i]] = n;
+                    tail[i] = n;
+                    count[i]++;
+                } else {
+                    int j = bs->mark[n] - m;
+                    int gi = group[i];
+                    int gj = group[j];
+                    if (gi != gj) {
+                        // the two parts are connected: join groups
+                        int g = gi < gj ? gi : gj;
+                        int o = gi < gj ? gj : gi;
+                        for (int s = 0; s < numParts; s++) {
+                            if (group[s] == o) {
+                                group[s] = g;
+                            }
+                        }
+                        numGroups--;
+                    }
+                }
+            }
+            head[i] = bs->qnext[h];
+
+            // is the group of search i done?
+            int done = 1;
+            for (int s = 0; s < numParts; s++) {
+                if (group[s] == group[i] && head[s] >= 0) {
+                    done = 0;
+                }
+            }
+            if (done && numGroups > 1) {
+                // a separate region: give it a new label
+                int g = group[i];
+                int nl = bs->nextLabel++;
+                bs->size[nl] = 0;
+                for (int s = 0; s < numParts; s++) {
+                    if (group[s] != g) {
+                        continue;
+                    }
+                    for (int v = reps[s]; v >= 0; v = bs->qnext[v]) {
+                        bs->label[v] = nl;
+                    }
+                    bs->size[nl] += count[s];
+                    group[s] = -1;
+                }
+                bs->size[l] -= bs->size[nl];
+                numGroups--;
+            }
+        }
+    }
+}
+
+
+/*
+ * Cell c was emptied: merge the regions around it.
+ */
+static void
+region_empty(int c) {
+    board_state_t* bs = &boardStates[get_game()];
+    // the biggest neighboring region keeps its label
+    int l = 0;
+    for (int i = 0; i < 4; i++) {
+        int nl = bs->label[c + bs->nb[i]];
+        if (nl && bs->size[nl] > bs->size[l]) {
+            l = nl;
+        }
+    }
+    if (l == 0) {
+        l = bs->nextLabel++;
+        bs->size[l] = 0;
+    }
+    bs->label[c] = l;
+    bs->size[l]++;
+    for (int i = 0; i < 4; i++) {
+        int nl = bs->label[c + bs->nb[i]];
+        if (nl && nl != l) {
+            bs->size[nl] = 0;
+            bs->size[l] += flood_label(c + bs->nb[i], l);
+        }
+    }
+}
+
+
+void
+put_board(const coord_t pos, cell_t element) {
+    board_state_t* bs = &boardStates[get_game()];
+    int c = pos.y * numCellsX + pos.x;
+    int wasEmpty = isempty(c);
+    if (bs->nextLabel + MAX_PARTS > bs->maxLabels) {
+        bs->upkeep += numCellsX * numCellsY;
+        relabel();
+    }
+    //put element onto board
+    if (bs->board[c] != CELL_EMPTY) {
+        bs->hash ^= hash_key(c, bs->board[c]);
+    }
+    bs->board[c] = element;
+    if (element != CELL_EMPTY) {
+        bs->hash ^= hash_key(c, element);
+    }
+    if (wasEmpty && !isempty(c)) {
+        bs->upkeep++;
+        region_fill(c);
+        pyramid_update(c, -1);
+    } else if (!wasEmpty && isempty(c)) {
+        bs->upkeep++;
+        region_empty(c);
+        pyramid_update(c, 1);
+    }
+}
+
+
+int
+isempty_cell(const coord_t pos) {
+    return isempty(pos.y * numCellsX + pos.x);
+}
+
+
+cell_t
+get_cell(const coord_t pos) {
+    board_state_t* bs = &boardStates[get_game()];
+    return bs->board[pos.y * numCellsX + pos.x];
+}
+
+
+/*
+ * Size of the region of empty cells containing pos; 0 if pos is not empty.
+ */
+int
+region_size(coord_t pos) {
+    board_state_t* bs = &boardStates[get_game()];
+    return bs->size[bs->label[pos.y * numCellsX + pos.x]];
+}
+
+
+/*
+ * Number of cells visited so far to keep the region sizes up to date, a
+ * machine independent measure of the cost of region_size().
+ */
+unsigned long
+region_upkeep() {
+    board_state_t* bs = &boardStates[get_game()];
+    return bs->upkeep;
+}
+
+
+/*
+ * Return 1 if a and b are empty cells of the same region, else 0.
+ */
+int
+region_same(coord_t a, coord_t b) {
+    board_state_t* bs = &boardStates[get_game()];
+    int la = bs->label[a.y * numCellsX + a.x];
+    return la != 0 && la == bs->label[b.y * numCellsX + b.x];
+}
+
+
+/*
+ * Move player p one cell in direction dir, and put it onto the board.
+ * The move can be taken back with move_undo().
+ * @return: 0 move was okay (new cell was empty); 1 cell was not empty
+ *          (the player crashed; the board is not changed)
+ */
+int
+move_apply(player_t* p, direction_t dir) {
+    board_state_t* bs = &boardStates[get_game()];
+    /* delta step (cells) */
+    static const coord_t delta[] = {{-1, 0}, {0,-1}, {1,0}, {0,1}};
+    undo_t* u = &bs->undoStack[bs->undoTop];
+    u->p = p;
+    u->pos = p->pos;
+    u->dir = p->direction;
+    bs->undoTop = (bs->undoTop + 1) % UNDO_LEN;
+    if (bs->undoDepth < UNDO_LEN) {
+        bs->undoDepth++;
+    }
+
+    p->direction = dir;
+    p->pos.x += delta[dir].x;
+    p->pos.y += delta[dir].y;
+    u->cell = get_cell(p->pos);
+    if (isempty_cell(p->pos)) {
+        put_board(p->pos, p->entity);
+        return 0;
+    }
+    return 1;
+}
+
+
+/*
+ * Take back the last move applied with move_apply().
+ */
+void
+move_undo() {
+    board_state_t* bs = &boardStates[get_game()];
+    assert(bs->undoDepth > 0);
+    bs->undoTop = (bs->undoTop + UNDO_LEN - 1) % UNDO_LEN;
+    bs->undoDepth--;
+    undo_t* u = &bs->undoStack[bs->undoTop];
+    if (isempty_element(u->cell)) {
+        put_board(u->p->pos, u->cell);
+    }
+    u->p->pos = u->pos;
+    u->p->direction = u->dir;
+}
+
+
+/*
+ * Block of level "level" the cell at pos is in.
+ */
+int
+block_index(int level, coord_t pos) {
+    board_state_t* bs = &boardStates[get_game()];
+    return (pos.y >> BLOCK_SHIFT(level)) * bs->levels[level].w
+            + (pos.x >> BLOCK_SHIFT(level));
+}
+
+
+/*
+ * Number of blocks of level "level"; blocks are numbered 0 ... count - 1.
+ */
+int
+block_count(int level) {
+    board_state_t* bs = &boardStates[get_game()];
+    return bs->levels[level].w * bs->levels[level].h;
+}
+
+
+/*
+ * Top left cell of block "block".
+ */
+coord_t
+block_origin(int level, int block) {
+    board_state_t* bs = &boardStates[get_game()];
+    int w = bs->levels[level].w;
+    return (coord_t){(block % w) << BLOCK_SHIFT(level),
+                     (block / w) << BLOCK_SHIFT(level)};
+}
+
+
+/*
+ * Neighbor of block "block" in direction dir; -1 at the edge of the board.
+ */
+int
+block_neighbor(int level, int block, direction_t dir) {
+    board_state_t* bs = &boardStates[get_game()];
+    const level_t* lv = &bs->levels[level];
+    int bx = block % lv->w;
+    int by = block / lv->w;
+    switch (dir) {
+    case West:  return bx > 0 ? block - 1 : -1;
+    case North: return by > 0 ? block - lv->w : -1;
+    case East:  return bx + 1 < lv->w ? block + 1 : -1;
+    case South: return by + 1 < lv->h ? block + lv->w : -1;
+    default:    assert(!"bad direction"); return -1;
+    }
+}
+
+
+/*
+ * Number of cells of block "block" (less than the block width squared for
+ * blocks at the right and bottom edges of the board).
+ */
+int
+block_cells(int level, int block) {
+    int bw = 1 << BLOCK_SHIFT(level);
+    coord_t o = block_origin(level, block);
+    int cw = numCellsX - o.x < bw ? numCellsX - o.x : bw;
+    int ch = numCellsY - o.y < bw ? numCellsY - o.y : bw;
+    return cw * ch;
+}
+
+
+/*
+ * Number of empty cells of block "block".
+ */
+int
+block_empty(int level, int block) {
+    board_state_t* bs = &boardStates[get_game()];
+    return bs->levels[level].empty[block];
+}
+
+
+/*
+ * Number of pairs of empty cells across the edge of block "block" in
+ * direction dir; 0 means no path of empty cells crosses this edge.
+ */
+int
+block_open(int level, int block, direction_t dir) {
+    board_state_t* bs = &boardStates[get_game()];
+    const level_t* lv = &bs->levels[level];
+    int n = block_neighbor(level, block, dir);
+    if (n < 0) {
+        return 0;
+    }
+    switch (dir) {
+    case West:  return lv->openE[n];
+    case North: return lv->openS[n];
+    case East:  return lv->openE[block];
+    default:    return lv->openS[block];
+    }
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef BOARD_H_
+#define BOARD_H_
+
+#include "tron.h"
+
+void board_init(int x, int y);
+void board_reset();
+uint64_t board_hash();
+
+/* number of moves move_undo() can take back at most */
+#define UNDO_LEN 4096
+
+int move_apply(player_t* p, direction_t dir);
+void move_undo();
+
+int region_size(coord_t pos);
+int region_same(coord_t a, coord_t b);
+unsigned long region_upkeep();
+
+/* levels of the occupancy pyramid: level l summarizes square blocks of
+ * 1 << BLOCK_SHIFT(l) cells width */
+#define BLOCK_LEVELS 2
+#define BLOCK_SHIFT(l) (3 + 2 * (l))
+
+int block_index(int level, coord_t pos);
+int block_count(int level);
+coord_t block_origin(int level, int block);
+int block_neighbor(int level, int block, direction_t dir);
+int block_cells(int level, int block);
+int block_empty(int level, int block);
+int block_open(int level, int block, direction_t dir);
+
+
+#endif /* BOARD_H_ */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Opening book. Every round starts from the same position, so the first
+ * moves of a computer player can be searched once, offline and much
+ * deeper than during the game (see tools/mkbook.c), and looked up here.
+ *
+ * File format ("book.bin" in the cpio archive; numbers little endian):
+ *
+ *   header:  "TRBK", version, number of sections
+ *   section: numCellsX (16 bit), numCellsY (16 bit), number of slots (32
+ *            bit; a power of two), the slots (64 bit each)
+ *
+ * There is one section per board size. A slot is 0 (empty) or holds the
+ * key of a position (book_key()) with the move, a direction, in its two
+ * lowest bits. A position is in slot key % slots or, if that is taken by
+ * another position, in one of the slots after it (wrapping around). The
+ * book is used in place; nothing is copied or decoded when it is loaded.
+ *
+ * Like the board, this does not depend on seL4; the host tools share it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "book.h"
+#include "board.h"
+
+/* the slots of the section for the current board size; NULL if none */
+static const uint8_t* slots = NULL;
+static uint32_t numSlots = 0;
+
+
+static uint32_t
+get16(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+}
+
+
+static uint32_t
+get32(const uint8_t* p) {
+    return get16(p) | get16(p + 2) << 16;
+}
+
+
+static uint64_t
+get64(const uint8_t* p) {
+    return get32(p) | (uint64_t)get32(p + 4) << 32;
+}
+
+
+/*
+ * Use the book in "data" (which must stay valid) for the current board
+ * size.
+ * @return: 0 okay; -1 the book is invalid or has no section for the board
+ */
+int
+book_load(const void* data, size_t size) {
+    const uint8_t* p = data;
+    slots = NULL;
+    numSlots = 0;
+    if (size < BOOK_HEADER_LEN || memcmp(p, "TRBK", 4) != 0
+    || p[4] != BOOK_VERSION) {
+        printf("book: invalid format\n");
+        return -1;
+    }
+    int numSections = p[5];
+    size_t pos = BOOK_HEADER_LEN;
+    for (int i = 0; i < numSections; i++) {
+        if (pos + BOOK_SECTION_LEN > size) {
+            break;
+        }
+        int x = get16(p + pos);
+        int y = get16(p + pos + 2);
+        uint32_t n = get32(p + pos + 4);
+        pos += BOOK_SECTION_LEN;
+        if (n == 0 || (n & (n - 1)) != 0 || n > (size - pos) / 8) {
+            break;
+        }
+        if (x == numCellsX && y == numCellsY) {
+            slots = p + pos;
+            numSlots = n;
+            return 0;
+        }
+        pos += 8 * (size_t)n;
+    }
+    printf("book: no moves for a %d x %d board\n", numCellsX, numCellsY);
+    return -1;
+}
+
+
+/*
+ * Key of the position player "me" is to move in: the board (that is, the
+ * trails of both players so far), whose move it is, and the directions of
+ * both players. The two lowest bits are 0.
+ */
+uint64_t
+book_key(const player_t* me, const player_t* you) {
+    uint64_t z = (uint64_t)me->entity << 4 | me->direction << 2
+            | you->direction;
+    z = (z + 0x9e3779b97f4a7c15ull) * 0xbf58476d1ce4e5b9ull;
+    uint64_t key = (board_hash() ^ z ^ (z >> 31)) & ~3ull;
+    // 0 marks empty slots
+    return key ? key : 4;
+}
+
+
+/*
+ * Look up the move of player "me" in the current position.
+ * @return: the direction to move in; -1 if the position is not in the book
+ */
+int
+book_lookup(const player_t* me, const player_t* you) {
+    if (slots == NULL) {
+        return -1;
+    }
+    uint64_t key = book_key(me, you);
+    uint32_t i = key % numSlots;
+    for (uint32_t n = 0; n < numSlots; n++, i = (i + 1) % numSlots) {
+        uint64_t slot = get64(slots + 8 * (size_t)i);
+        if (slot == 0) {
+            return -1;
+        }
+        if ((slot & ~3ull) == key) {
+            return slot & 3;
+        }
+    }
+    return -1;
+}
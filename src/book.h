@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef BOOK_H_
+#define BOOK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tron.h"
+
+#define BOOK_VERSION 1
+
+/* size of the file header and of a section header (bytes) */
+#define BOOK_HEADER_LEN 6
+#define BOOK_SECTION_LEN 8
+
+int book_load(const void* data, size_t size);
+uint64_t book_key(const player_t* me, const player_t* you);
+int book_lookup(const player_t* me, const player_t* you);
+
+
+#endif /* BOOK_H_ */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Boot profiler: main() and main_continued() call bootprof_mark() at the
+ * end of every phase of the start up. Marks only read the TSC, so they
+ * are cheap enough to stay in, and work before the timers (or even the
+ * serial port) are set up. Once the start screen is up, bootprof_report()
+ * prints how long each phase took.
+ */
+
+#include <stdio.h>
+#include <platsupport/timer.h>
+#include "tron.h"
+#include "bootprof.h"
+
+/* maximum number of phases */
+#define MAX_PHASES 24
+
+typedef struct {
+    const char* name;
+    /* TSC at the end of the phase */
+    uint64_t tsc;
+} phase_t;
+
+static phase_t phases[MAX_PHASES];
+static int numPhases = 0;
+
+
+/*
+ * Mark the end of boot phase "phase" (the first mark starts the clock).
+ * @param phase: name of the phase; must be a string literal (or live
+ *               until bootprof_report())
+ */
+void
+bootprof_mark(const char* phase) {
+    if (numPhases < MAX_PHASES) {
+        phases[numPhases].name = phase;
+        phases[numPhases].tsc = read_tsc();
+        numPhases++;
+    }
+}
+
+
+/*
+ * Print the time each phase took, as a table. Needs the timers: the TSC
+ * frequency is measured against get_current_time() here.
+ */
+void
+bootprof_report() {
+    if (numPhases < 2) {
+        return;
+    }
+
+    // about 1 ms
+    uint64_t t0 = get_current_time();
+    uint64_t c0 = read_tsc();
+    while (get_current_time() - t0 < NS_IN_MS) {
+        /* busy wait */
+    }
+    uint64_t t1 = get_current_time();
+    uint64_t c1 = read_tsc();
+    // TSC ticks per microsecond
+    uint64_t perUs = (c1 - c0) * 1000 / (t1 - t0);
+    if (perUs == 0) {
+        perUs = 1;
+    }
+
+    uint64_t total = phases[numPhases - 1].tsc - phases[0].tsc;
+    printf("=== boot profile (TSC %llu MHz) ===\n", (unsigned long long)perUs);
+    printf("%-24s %12s %10s %6s\n", "phase", "cycles", "us", "%");
+    for (int i = 1; i < numPhases; i++) {
+        uint64_t c = phases[i].tsc - phases[i - 1].tsc;
+        printf("%-24s %12llu %10llu %5llu%%\n", phases[i].name,
+                (unsigned long long)c, (unsigned long long)(c / perUs),
+                (unsigned long long)(total ? c * 100 / total : 0));
+    }
+    printf("%-24s %12llu %10llu\n", "total", (unsigned long long)total,
+            (unsigned long long)(total / perUs));
+    printf("=== boot profile end ===\n");
+}
@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef BOOTPROF_H_
+#define BOOTPROF_H_
+
+void bootprof_mark(const char* phase);
+void bootprof_report();
+
+
+#endif /* BOOTPROF_H_ */
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * A linear evaluation function for the position a player reaches with a
+ * move. The weights are trained offline and loaded at startup (file
+ * "evalweights.txt" in the cpio archive). Everything is integer arithmetic
+ * in fixed point (see EVAL_FRAC) because the x86_64 build does not use
+ * SSE (-mno-sse), which makes floating point slow.
+ *
+ * Features (all in the range 0 ... EVAL_ONE):
+ *   0      bias (always EVAL_ONE)
+ *   1-8    local occupancy around the new position, relative to the new
+ *          direction: forward, left, right, forward-left, forward-right,
+ *          back-left, back-right, two cells forward (EVAL_ONE if blocked)
+ *   9      reachable area from the new position (EVAL_ONE at the cutoff)
+ *   10     distance to the opponent (Manhattan; EVAL_ONE at 64 cells)
+ *   11     head-on risk: opponent's next cell is the new position
+ *   12-15  quadrant the opponent is in relative to the new position and
+ *          direction (one-hot)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "evaluate.h"
+
+/* the weights; valid if "loaded" is set */
+static int32_t weights[EVAL_FEATURES];
+static int loaded = 0;
+
+/* statistics: number of evaluated positions and cycles spent; several
+ * threads evaluate at the same time (AI threads, multi-board games), so
+ * they are only updated atomically (a plain 64 bit add tears on ia32) */
+static uint64_t evalCycles = 0;
+static unsigned long evalPositions = 0;
+
+
+/*
+ * Load weights from a text file: the keyword "weights", the number of
+ * weights (EVAL_FEATURES), and the weights as integers in fixed point.
+ * Lines starting with '#' are comments.
+ * @return: 0 okay; -1 format error (the evaluation stays disabled)
+ */
+int
+eval_load(const char* text, size_t size) {
+    char buf[1024];
+    if (text == NULL || size >= sizeof(buf)) {
+        return -1;
+    }
+    // copy, so that the text is terminated and comments can be removed
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = text[i];
+    }
+    buf[size] = 0;
+    for (char* c = buf; *c; c++) {
+        if (*c == '#') {
+            while (*c && *c != '\n') {
+                *c++ = ' ';
+            }
+            if (!*c) {
+                break;
+            }
+        }
+    }
+
+    int n = 0;
+    int pos = 0;
+    if (sscanf(buf, " weights %d%n", &n, &pos) != 1 || n != EVAL_FEATURES) {
+        printf("evaluation weights: invalid header\n");
+        return -1;
+    }
+    char* s = buf + pos;
+    for (int i = 0; i < EVAL_FEATURES; i++) {
+        char* end;
+        weights[i] = strtol(s, &end, 10);
+        if (end == s) {
+            printf("evaluation weights: expected %d weights\n", EVAL_FEATURES);
+            return -1;
+        }
+        s = end;
+    }
+    loaded = 1;
+    return 0;
+}
+
+
+/*
+ * Write the weights to "text" (at most "size" bytes, terminated), in the
+ * format eval_load() reads.
+ * @return: length of the text
+ */
+int
+eval_save(char* text, size_t size) {
+    // one line per group of features (see above)
+    static const int groups[] = {1, 8, 3, 4};
+    int len = snprintf(text, size, "weights %d\n", EVAL_FEATURES);
+    int i = 0;
+    for (int g = 0; g < 4 && len < (int)size; g++) {
+        for (int j = 0; j < groups[g] && len < (int)size; j++, i++) {
+            len += snprintf(text + len, size - len, "%d%s", (int)weights[i],
+                    j + 1 < groups[g] ? " " : "\n");
+        }
+    }
+    return len < (int)size ? len : (int)size - 1;
+}
+
+
+/*
+ * Set the weights (EVAL_FEATURES numbers in fixed point), or disable the
+ * evaluation ("w" NULL). Call only while no AI is searching.
+ */
+void
+eval_set_weights(const int32_t* w) {
+    if (w == NULL) {
+        loaded = 0;
+        return;
+    }
+    for (int i = 0; i < EVAL_FEATURES; i++) {
+        weights[i] = w[i];
+    }
+    loaded = 1;
+}
+
+
+/*
+ * Get the weights.
+ * @return: 0 okay; -1 no weights are loaded
+ */
+int
+eval_get_weights(int32_t* w) {
+    for (int i = 0; i < EVAL_FEATURES; i++) {
+        w[i] = weights[i];
+    }
+    return loaded ? 0 : -1;
+}
+
+
+/*
+ * Return 1 if weights have been loaded, else 0.
+ */
+int
+eval_isloaded() {
+    return loaded;
+}
+
+
+/*
+ * Return EVAL_ONE if cell at pos is off the board or not empty, else 0.
+ */
+static int32_t
+blocked(coord_t pos) {
+    if (pos.x < 0 || pos.y < 0 || pos.x >= numCellsX || pos.y >= numCellsY) {
+        return EVAL_ONE;
+    }
+    return isempty_cell(pos) ? 0 : EVAL_ONE;
+}
+
+
+/*
+ * Position of the cell "fwd" cells forward and "side" cells to the right
+ * (negative: to the left) of pos when facing dir.
+ */
+static coord_t
+relative(coord_t pos, direction_t dir, int fwd, int side) {
+    static const coord_t ahead[] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+    coord_t f = ahead[dir];
+    coord_t r = ahead[(dir + 1) % DirLength];
+    return (coord_t){pos.x + fwd * f.x + side * r.x,
+                     pos.y + fwd * f.y + side * r.y};
+}
+
+
+/*
+ * Compute the features of the position a player reaches when moving to
+ * npos in direction ndir.
+ * @param area: reachable area from npos (fixed point, 0 ... EVAL_ONE)
+ * @param you: the opponent
+ */
+void
+eval_extract(int32_t f[EVAL_FEATURES], coord_t npos, direction_t ndir,
+        int32_t area, const player_t* you) {
+    f[0] = EVAL_ONE;
+    f[1] = blocked(relative(npos, ndir, 1, 0));
+    f[2] = blocked(relative(npos, ndir, 0, -1));
+    f[3] = blocked(relative(npos, ndir, 0, 1));
+    f[4] = blocked(relative(npos, ndir, 1, -1));
+    f[5] = blocked(relative(npos, ndir, 1, 1));
+    f[6] = blocked(relative(npos, ndir, -1, -1));
+    f[7] = blocked(relative(npos, ndir, -1, 1));
+    f[8] = blocked(relative(npos, ndir, 2, 0));
+    f[9] = area;
+
+    int dx = you->pos.x - npos.x;
+    int dy = you->pos.y - npos.y;
+    int dist = abs(dx) + abs(dy);
+    f[10] = (dist < 64 ? dist : 64) * EVAL_ONE / 64;
+
+    coord_t ynext = relative(you->pos, you->direction, 1, 0);
+    f[11] = (ynext.x == npos.x && ynext.y == npos.y) ? EVAL_ONE : 0;
+
+    // opponent's position in the coordinate system of the player:
+    // "fwd" along ndir, "side" to the right
+    static const coord_t ahead[] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+    int fwd = dx * ahead[ndir].x + dy * ahead[ndir].y;
+    int side = dx * ahead[(ndir + 1) % DirLength].x
+             + dy * ahead[(ndir + 1) % DirLength].y;
+    int quadrant = fwd >= 0 ? (side >= 0 ? 0 : 1) : (side >= 0 ? 3 : 2);
+    for (int i = 0; i < 4; i++) {
+        f[12 + i] = (i == quadrant) ? EVAL_ONE : 0;
+    }
+}
+
+
+/*
+ * Score of a feature vector (fixed point; higher is better).
+ */
+int32_t
+eval_score(const int32_t f[EVAL_FEATURES]) {
+    assert(loaded);
+    int32_t sum = 0;
+    for (int i = 0; i < EVAL_FEATURES; i++) {
+        sum += weights[i] * f[i];
+    }
+    return sum >> EVAL_FRAC;
+}
+
+
+/*
+ * Extract features and score them; keeps track of the cost.
+ */
+int32_t
+eval_move(coord_t npos, direction_t ndir, int32_t area, const player_t* you) {
+    uint64_t start = read_tsc();
+    int32_t f[EVAL_FEATURES];
+    eval_extract(f, npos, ndir, area, you);
+    int32_t score = eval_score(f);
+    __atomic_fetch_add(&evalCycles, read_tsc() - start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&evalPositions, 1, __ATOMIC_RELAXED);
+    return score;
+}
+
+
+/*
+ * Get the number of positions evaluated and the cycles spent doing so.
+ */
+void
+eval_get_stats(uint64_t* cycles, unsigned long* positions) {
+    *cycles = __atomic_load_n(&evalCycles, __ATOMIC_RELAXED);
+    *positions = __atomic_load_n(&evalPositions, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef EVALUATE_H_
+#define EVALUATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tron.h"
+
+/* number of features (and weights) of the evaluation function */
+#define EVAL_FEATURES 16
+
+/* features and weights are fixed-point numbers with EVAL_FRAC bits after
+   the binary point; i.e. 1.0 is (1 << EVAL_FRAC) */
+#define EVAL_FRAC 8
+#define EVAL_ONE (1 << EVAL_FRAC)
+
+int eval_load(const char* text, size_t size);
+int eval_save(char* text, size_t size);
+void eval_set_weights(const int32_t* w);
+int eval_get_weights(int32_t* w);
+int eval_isloaded();
+void eval_extract(int32_t f[EVAL_FEATURES], coord_t npos, direction_t ndir,
+        int32_t area, const player_t* you);
+int32_t eval_score(const int32_t f[EVAL_FEATURES]);
+int32_t eval_move(coord_t npos, direction_t ndir, int32_t area,
+        const player_t* you);
+void eval_get_stats(uint64_t* cycles, unsigned long* positions);
+
+
+#endif /* EVALUATE_H_ */
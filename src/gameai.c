@@ -21,9 +21,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
 #include <utils/attribute.h>
 #include "tron.h"
+#include "board.h"
+#include "arena.h"
+#include "evaluate.h"
+#include "oppmodel.h"
+#include "book.h"
 
 
 /* index into conditions ("cond") of a rules */
@@ -173,44 +179,364 @@ get_direction(direction_t dir, action_t action) {
 }
 
 
-/* The value recursive functions write to cells to indicate that an empty
- * cell is no longer empty.
- * The value is only used by functions that explore the board for
- * heuristics. Cells marked with this value must be treated
- * like CELL_EMPTY by the actual game play logic.
+/* The cutoff value at which the flood fill is terminated. */
+static int cutoff = 200;
+
+/* cutoff of the levels that do not set their own (see rules_load()) */
+static int defaultCutoff = 200;
+
+/* when forward is blocked, the side with this many more empty cells than
+ * the other is the only one that is ok (see read_detectors()) */
+static int diff = 5;
+
+/*
+ * Difficulty levels. Apart from level 0, a level is a fixed amount of
+ * work per move (see ai_state_t.work) and a cutoff, so that a level makes
+ * the same moves at the same cost on any machine, however fast it is.
+ * The weaker levels also do not know the region sizes the board keeps
+ * track of; they have to flood fill instead, and do not get far with
+ * their budget, and the weakest does not use the opening book. The levels
+ * that know the region sizes also look a tick ahead. Level 0 searches
+ * until the time for the move is up.
  */
-static int traceValue;
+typedef struct {
+    const char* name;
+    /* 0: defaultCutoff */
+    int cutoff;
+    /* work per move; 0: limited by time only */
+    unsigned long budget;
+    /* look up region sizes instead of flood filling */
+    int regions;
+    /* play the opening from the book (see book.c) */
+    int book;
+    /* drop the rules whose moves the opponent can answer by cutting us
+     * off (see look_ahead()); needs "regions" */
+    int lookahead;
+} ai_level_t;
+
+static const ai_level_t aiLevels[AI_LEVELS] = {
+    { "timed",    0, 0,    1, 1, 1 },
+    { "easy",    25, 64,   0, 0, 0 },
+    { "normal", 100, 512,  0, 1, 0 },
+    { "hard",     0, 4096, 1, 1, 1 },
+};
+
+static int aiLevel = 2;
+
+/* The AI calls poll_during_search() after this many units of work, so
+ * that the game can read the keyboard and the AI can check its time. */
+#define POLL_INTERVAL 256
+
+/*
+ * State of the AI of one computer player. The AI only reads the board and
+ * keeps everything it writes in here, so that the AIs of both players can
+ * run at the same time (see aithread.c).
+ */
+typedef struct {
+    /* memory for all per-move data */
+    arena_t arena;
+    /* Explicit stack of the flood fill below. Each cell is pushed at most
+     * once, so the board size bounds the stack size. Allocated from the
+     * arena at the beginning of each move. Cells outside the near field
+     * are kept at the end of the stack, from farTop to the board size. */
+    coord_t* fillStack;
+    int farTop;
+    /* cells the flood fill has visited: visited[y * numCellsX + x] is
+     * equal to stamp; a new flood fill uses a new stamp */
+    uint32_t* visited;
+    uint32_t stamp;
+    /* the near field: the 3x3 blocks (level 0) around the start of the
+     * fill; cells in [nearMin, nearMax) are searched one by one first */
+    coord_t nearMin;
+    coord_t nearMax;
+    int nearOnly;
+    /* the same for the searches on the occupancy pyramid: blocks visited,
+     * per level, and a queue of blocks (allocated from the arena) */
+    uint32_t* blockVisited[BLOCK_LEVELS];
+    uint32_t blockStamp;
+    int* blockQueue;
+    /* work done for the current move: number of cells and pyramid blocks
+     * visited, plus one per region size looked up; at the levels that look
+     * up region sizes, also the cells the board visited to keep them up
+     * to date since the last move (see region_upkeep()) */
+    unsigned long work;
+    /* region_upkeep() at the last move (see forget_computer_upkeep()) */
+    unsigned long upkeep;
+    /* time the current move must be decided by */
+    uint64_t endTime;
+    /* set when endTime has passed (level 0) or the work budget of the
+     * level is used up; no further searching for this move */
+    int timedOut;
+    /* the opponent's next cell, if the opponent model is confident about
+     * it; the search then assumes the opponent moves there */
+    int hasPrediction;
+    coord_t predicted;
+} ai_state_t;
+
+/* per game (see get_game()) and player */
+static ai_state_t aiState[MAX_GAMES][NUMPLAYERS];
+
+/* per game: set while both computer players decide on the board at the
+ * same time (see share_computer_board()) */
+static int boardShared[MAX_GAMES];
+
+
+/*
+ * Charge "n" units of work to the current move. Every POLL_INTERVAL units,
+ * poll the keyboard (and, at level 0, the time); stop the search once the
+ * work budget of the level is used up.
+ */
+static void
+add_work(ai_state_t* ai, unsigned long n) {
+    unsigned long budget = aiLevels[aiLevel].budget;
+    unsigned long before = ai->work;
+    ai->work += n;
+    if (ai->work / POLL_INTERVAL != before / POLL_INTERVAL) {
+        // keep the keyboard drained, but only level 0 minds the time
+        int late = poll_during_search(ai->endTime);
+        if (budget == 0) {
+            ai->timedOut = late;
+        }
+    }
+    if (budget > 0 && ai->work >= budget) {
+        ai->timedOut = 1;
+    }
+}
+
+
+/*
+ * Helper function for count_emptyCells(): if the cell at pos is empty, then
+ * mark it, count it, and push it onto the stack. Empty cells outside the
+ * near field are only marked and put aside (while ai->nearOnly).
+ */
+static inline void
+push_emptyCell(ai_state_t* ai, coord_t pos, int* top, int* count) {
+    uint32_t* v = &ai->visited[pos.y * numCellsX + pos.x];
+    if (*v == ai->stamp || !isempty_cell(pos)) {
+        //cell at location "pos" is not empty (or was counted already)
+        return;
+    }
+    if (ai->hasPrediction
+    && pos.x == ai->predicted.x && pos.y == ai->predicted.y) {
+        //the opponent will most likely be there
+        return;
+    }
+    *v = ai->stamp;
+    if (ai->nearOnly
+    && (pos.x < ai->nearMin.x || pos.x >= ai->nearMax.x
+     || pos.y < ai->nearMin.y || pos.y >= ai->nearMax.y)) {
+        ai->fillStack[--ai->farTop] = pos;
+        return;
+    }
+    (*count)++;
+    ai->fillStack[(*top)++] = pos;
+    add_work(ai, 1);
+}
+
+
+/*
+ * Get a new stamp for the searches on the occupancy pyramid.
+ */
+static uint32_t
+new_blockStamp(ai_state_t* ai) {
+    if (++ai->blockStamp == 0) {
+        for (int l = 0; l < BLOCK_LEVELS; l++) {
+            memset(ai->blockVisited[l], 0, block_count(l) * sizeof(uint32_t));
+        }
+        ai->blockStamp = 1;
+    }
+    return ai->blockStamp;
+}
+
+
+/*
+ * Return 1 if block "b" of level "level" has no cell in the near field,
+ * is completely empty, and does not hold the predicted opponent cell:
+ * then all its cells can be reached from any one of them.
+ */
+static int
+is_farAndFull(ai_state_t* ai, int level, int b) {
+    int bw = 1 << BLOCK_SHIFT(level);
+    coord_t o = block_origin(level, b);
+    if (o.x < ai->nearMax.x && o.x + bw > ai->nearMin.x
+    && o.y < ai->nearMax.y && o.y + bw > ai->nearMin.y) {
+        return 0;
+    }
+    if (ai->hasPrediction && block_index(level, ai->predicted) == b) {
+        return 0;
+    }
+    return block_empty(level, b) == block_cells(level, b);
+}
+
+
+/*
+ * Lower bound on the number of empty cells reachable from the cells the
+ * near field fill put aside: the cells of the completely empty blocks they
+ * are in, and of the completely empty blocks connected to those. Where a
+ * whole 32x32 block is empty, its cells are counted at once. Gives up once
+ * the bound exceeds "limit".
+ */
+static int
+far_lowerBound(ai_state_t* ai, int limit) {
+    int numCells = numCellsX * numCellsY;
+    uint32_t stamp = new_blockStamp(ai);
+    int lower = 0;
+    int head = 0;
+    int tail = 0;
+    int visits = 0;
+    for (int i = ai->farTop; i <= numCells && lower <= limit; i++) {
+        if (head == tail) {
+            // start from the next cell put aside
+            if (i == numCells) {
+                break;
+            }
+            visits++;
+            int b = block_index(0, ai->fillStack[i]);
+            if (ai->blockVisited[0][b] == stamp) {
+                continue;
+            }
+            ai->blockVisited[0][b] = stamp;
+            if (!is_farAndFull(ai, 0, b)) {
+                continue;
+            }
+            ai->blockQueue[tail++] = b;
+        }
+        while (head < tail && lower <= limit) {
+            int b = ai->blockQueue[head++];
+            visits++;
+            int sb = block_index(1, block_origin(0, b));
+            if (!is_farAndFull(ai, 1, sb)) {
+                lower += block_cells(0, b);
+            } else if (ai->blockVisited[1][sb] != stamp) {
+                ai->blockVisited[1][sb] = stamp;
+                lower += block_cells(1, sb);
+            }
+            for (direction_t d = West; d < DirLength; d++) {
+                int n = block_neighbor(0, b, d);
+                if (n >= 0 && ai->blockVisited[0][n] != stamp) {
+                    ai->blockVisited[0][n] = stamp;
+                    if (is_farAndFull(ai, 0, n)) {
+                        ai->blockQueue[tail++] = n;
+                    }
+                }
+            }
+        }
+    }
+    add_work(ai, visits);
+    return lower;
+}
+
+
+/*
+ * Upper bound on the number of empty cells reachable from the unfinished
+ * fill (the cells on the stack, and the cells put aside): the empty cells
+ * of all blocks reachable through open block edges. Gives up once the
+ * bound exceeds "limit".
+ */
+static int
+frontier_upperBound(ai_state_t* ai, int top, int limit) {
+    int numCells = numCellsX * numCellsY;
+    uint32_t stamp = new_blockStamp(ai);
+    int upper = 0;
+    int head = 0;
+    int tail = 0;
+    int visits = 0;
+    for (int i = 0; i < numCells && upper <= limit; i++) {
+        if (i == top) {
+            // skip the unused part of the stack
+            i = ai->farTop;
+            if (i == numCells) {
+                break;
+            }
+        }
+        visits++;
+        int b = block_index(0, ai->fillStack[i]);
+        if (ai->blockVisited[0][b] == stamp) {
+            continue;
+        }
+        ai->blockVisited[0][b] = stamp;
+        ai->blockQueue[tail++] = b;
+        while (head < tail && upper <= limit) {
+            b = ai->blockQueue[head++];
+            visits++;
+            upper += block_empty(0, b);
+            for (direction_t d = West; d < DirLength; d++) {
+                int n = block_neighbor(0, b, d);
+                if (n >= 0 && ai->blockVisited[0][n] != stamp
+                && block_open(0, b, d) > 0) {
+                    ai->blockVisited[0][n] = stamp;
+                    ai->blockQueue[tail++] = n;
+                }
+            }
+        }
+    }
+    add_work(ai, visits);
+    return upper;
+}
 
-/* The cutoff value at which recursion is terminated. */
-static int cutoff = 200;
 
 /*
  * Count number of empty cells potentially reachable from position pos.
  * This count is an upper bound, as the allowed moves are more restrictive
  * than the moves exercised here. (Think "flood fill" in a paint program.)
- * @param pos: current location
+ * The fill stops as soon as count exceeds cutoff, so that the cost of a
+ * call does not depend on the size of the board.
+ *
+ * The fill first stays in the near field around pos. If it leaves the
+ * near field, the occupancy pyramid of the board often shows that enough
+ * cells are reachable further away; only otherwise (e.g. behind a
+ * bottleneck) is the fill continued cell by cell. When the time for the
+ * move is up (ai->timedOut), the pyramid gives an upper bound instead.
+ * @param pos: start location
  * @param count: number of empty cells found
  */
 static void
-count_emptyCells(coord_t pos, int* count) {
-    cell_t cell = get_cell(pos);
-    if (cell == traceValue || cell == CELL_P0
-    || cell == CELL_P1 || cell == CELL_WALL) {
-        //cell at location "pos" is not empty
-        return;
+count_emptyCells(ai_state_t* ai, coord_t pos, int* count) {
+    int numCells = numCellsX * numCellsY;
+    int top = 0;
+    if (++ai->stamp == 0) {
+        // stamps wrapped around; start over with a clean slate
+        memset(ai->visited, 0, numCells * sizeof(uint32_t));
+        ai->stamp = 1;
     }
-    // put a "trace value" into cell leaving a trail and marking it non-empty
-    put_board(pos, traceValue);
-    if (++(*count) >= cutoff) {
-        //Count could end up being greater than cutoff because we keep
-        //increasing the count as the recursion unwinds. This is on purpose
-        //as it makes count more accurate.
-        return;
+    int bw = 1 << BLOCK_SHIFT(0);
+    ai->nearMin.x = ((pos.x / bw) - 1) * bw;
+    ai->nearMin.y = ((pos.y / bw) - 1) * bw;
+    ai->nearMax.x = ((pos.x / bw) + 2) * bw;
+    ai->nearMax.y = ((pos.y / bw) + 2) * bw;
+    ai->nearOnly = 1;
+    ai->farTop = numCells;
+
+    push_emptyCell(ai, pos, &top, count);
+    while (top > 0 && *count <= cutoff && !ai->timedOut) {
+        pos = ai->fillStack[--top];
+        push_emptyCell(ai, (coord_t){pos.x - 1, pos.y}, &top, count);
+        push_emptyCell(ai, (coord_t){pos.x, pos.y - 1}, &top, count);
+        push_emptyCell(ai, (coord_t){pos.x + 1, pos.y}, &top, count);
+        push_emptyCell(ai, (coord_t){pos.x, pos.y + 1}, &top, count);
+
+        if (top == 0 && ai->farTop < numCells && !ai->timedOut) {
+            // the near field is done, and the fill went beyond it
+            int lower = far_lowerBound(ai, cutoff - *count);
+            if (*count + lower > cutoff) {
+                *count += lower;
+                break;
+            }
+            // continue the fill cell by cell
+            ai->nearOnly = 0;
+            add_work(ai, numCells - ai->farTop);
+            while (ai->farTop < numCells) {
+                ai->fillStack[top++] = ai->fillStack[ai->farTop++];
+                (*count)++;
+            }
+        }
+    }
+
+    if (ai->timedOut) {
+        // no time to look all the way: assume the best the pyramid allows
+        int upper = *count + frontier_upperBound(ai, top, cutoff - *count);
+        *count = upper > cutoff ? cutoff + 1 : upper;
     }
-    count_emptyCells((coord_t){pos.x - 1, pos.y}, count);
-    count_emptyCells((coord_t){pos.x, pos.y - 1}, count);
-    count_emptyCells((coord_t){pos.x + 1, pos.y}, count);
-    count_emptyCells((coord_t){pos.x, pos.y + 1}, count);
 }
 
 
@@ -218,13 +544,21 @@ count_emptyCells(coord_t pos, int* count) {
  * Helper function for classifier below.
  */
 static void
-read_detectors_direction(coord_t pos, int* count, char* isempty, char* isok) {
+read_detectors_direction(ai_state_t* ai, coord_t pos, int* count,
+        char* isempty, char* isok) {
     *count = 0;
     if (isempty_cell(pos)) {
         *isempty = '1';
-        traceValue++;
-        assert(traceValue > CELL_LEN);
-        count_emptyCells(pos, count);
+        if (aiLevels[aiLevel].regions
+        && (!ai->hasPrediction || !region_same(pos, ai->predicted))) {
+            // the board keeps track of regions; no need to flood fill
+            // (the count is capped the same way the fill is)
+            add_work(ai, 1);
+            int size = region_size(pos);
+            *count = size > cutoff ? cutoff + 1 : size;
+        } else {
+            count_emptyCells(ai, pos, count);
+        }
         *isok = *count > cutoff ? '1' : '0';
     } else {
         *isempty = *isok = '0';
@@ -235,9 +569,11 @@ read_detectors_direction(coord_t pos, int* count, char* isempty, char* isok) {
 /*
  * The "detector" examines the "environment" (i.g. the game state) and
  * crafts a "message" (an encoding of the game state).
+ * @param counts: returns the number of empty cells found for each action
  */
 static void
-read_detectors(char *msg, player_t* me, player_t* you) {
+read_detectors(ai_state_t* ai, char *msg, player_t* me, player_t* you,
+        int counts[ActionLen]) {
     coord_t pos;
     int countf = 0; // number of empty cells in forward direction
     int countl = 0; // in left direction
@@ -245,22 +581,21 @@ read_detectors(char *msg, player_t* me, player_t* you) {
 
     //-----forward
     pos = get_newpos(me->pos, me->direction, MoveForward);
-    read_detectors_direction(pos, &countf,
+    read_detectors_direction(ai, pos, &countf,
             msg + CI_FORWARD_ISEMPTY, msg + CI_FORWARD_ISOK);
     //-----left
     pos = get_newpos(me->pos, me->direction, MoveLeft);
-    read_detectors_direction(pos, &countl,
+    read_detectors_direction(ai, pos, &countl,
             msg + CI_LEFT_ISEMPTY, msg + CI_LEFT_ISOK);
     //-----right
     pos = get_newpos(me->pos, me->direction, MoveRight);
-    read_detectors_direction(pos, &countr,
+    read_detectors_direction(ai, pos, &countr,
             msg + CI_RIGHT_ISEMPTY, msg + CI_RIGHT_ISOK);
 
     //-----check left/right
     if (countf == 0 && countl > 0 && countr > 0) {
         //forward is blocked; left and right are open
         //favor direction with more empty cells
-        const int diff = 5;
         if (countl - countr > diff) {
             //left are more empty cells than right
             msg[CI_LEFT_ISOK] = '1';
@@ -295,6 +630,9 @@ read_detectors(char *msg, player_t* me, player_t* you) {
 
     //------------
     msg[CI_LAST] = 0;
+    counts[MoveForward] = countf;
+    counts[MoveLeft] = countl;
+    counts[MoveRight] = countr;
 
     dprintf ("me (player %d) : x=%d y=%d dir=%d (%s)\n",
             me->entity, me->pos.x, me->pos.y, me->direction,
@@ -367,11 +705,215 @@ debug_print_rules(int* matches, int numMatches, int ruleid) {
     dprintf("picking rule num: %d\n", ruleid);
 }
 
+/* Matching rules whose action scores this much (fixed point) below the
+ * best action are dropped when an evaluation function is loaded. */
+#define EVAL_MARGIN (EVAL_ONE / 4)
+
+/*
+ * Use the evaluation function (if loaded) to drop matching rules with
+ * actions that look clearly worse than the best action. At least one
+ * rule is always kept.
+ */
+static void
+prune_rules(player_t* me, player_t* you, int counts[ActionLen],
+        int* matches, int* numMatches) {
+    if (!eval_isloaded()) {
+        return;
+    }
+    int32_t score[ActionLen];
+    int32_t best = INT32_MIN;
+    for (int a = 0; a < ActionLen; a++) {
+        coord_t npos = get_newpos(me->pos, me->direction, a);
+        if (!isempty_cell(npos)) {
+            score[a] = INT32_MIN;
+            continue;
+        }
+        int32_t area = counts[a] > cutoff ? EVAL_ONE
+                                          : counts[a] * EVAL_ONE / cutoff;
+        score[a] = eval_move(npos, get_direction(me->direction, a), area, you);
+        if (score[a] > best) {
+            best = score[a];
+        }
+    }
+    if (best == INT32_MIN) {
+        // all moves are fatal
+        return;
+    }
+    int n = 0;
+    for (int i = 0; i < *numMatches; i++) {
+        if (score[rules[matches[i]].action] >= best - EVAL_MARGIN) {
+            matches[n++] = matches[i];
+        }
+    }
+    if (n > 0) {
+        *numMatches = n;
+    }
+    dprintf("eval: forward=%d left=%d right=%d; %d rules left\n",
+            score[MoveForward], score[MoveLeft], score[MoveRight], *numMatches);
+}
+
+
+/*
+ * Size of the largest region of empty cells "me" can move into next
+ * (capped the way the flood fill is); 0 if "me" is boxed in.
+ */
+static int
+room(ai_state_t* ai, player_t* me) {
+    int size = 0;
+    for (action_t a = MoveForward; a < ActionLen; a++) {
+        coord_t pos = get_newpos(me->pos, me->direction, a);
+        if (isempty_cell(pos) && region_size(pos) > size) {
+            size = region_size(pos);
+        }
+    }
+    add_work(ai, ActionLen);
+    return size > cutoff ? cutoff + 1 : size;
+}
+
+
+/*
+ * Look a tick ahead: make each move of "me", answer it with each move of
+ * "you", and see how much room "me" is left with (taking the moves back
+ * with move_undo()). Of the rules the evaluation function has left (see
+ * prune_rules()), drop those whose moves leave "me" no more than the
+ * cutoff (in the worst case) while another move leaves more. At least one
+ * rule is always kept.
+ *
+ * The opponent's replies are tried in the order the opponent model
+ * predicts them, the likeliest first; a move is given up on as soon as one
+ * reply leaves less room than the best move so far. A reply into the cell
+ * "me" moves to counts as boxing "me" in (the players crash head-on).
+ * The cells the board visits to keep the regions up to date as the moves
+ * are made and taken back are charged to the move (see region_upkeep()),
+ * not to the opponent's next move.
+ */
+static void
+look_ahead(ai_state_t* ai, player_t* me, player_t* you, int* matches,
+        int* numMatches) {
+    if (!aiLevels[aiLevel].lookahead || boardShared[get_game()]) {
+        return;
+    }
+    int probs[OPP_ACTIONS];
+    opp_model_predict(you, probs);
+    action_t order[ActionLen] = { MoveForward, MoveLeft, MoveRight };
+    for (int i = 1; i < ActionLen; i++) {
+        for (int j = i; j > 0 && probs[order[j]] > probs[order[j - 1]]; j--) {
+            action_t t = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = t;
+        }
+    }
+
+    const unsigned long upkeep = region_upkeep();
+    // room left after the worst reply; -1: not looked at
+    int score[ActionLen];
+    int best = -1;
+    for (action_t a = MoveForward; a < ActionLen; a++) {
+        score[a] = -1;
+        if (ai->timedOut || !isempty_cell(get_newpos(me->pos, me->direction,
+                a))) {
+            continue;
+        }
+        move_apply(me, get_direction(me->direction, a));
+        int worst = INT_MAX;
+        for (int i = 0; i < ActionLen && worst > best && !ai->timedOut; i++) {
+            coord_t pos = get_newpos(you->pos, you->direction, order[i]);
+            if (pos.x == me->pos.x && pos.y == me->pos.y) {
+                worst = 0;
+            } else if (isempty_cell(pos)) {
+                move_apply(you, get_direction(you->direction, order[i]));
+                int r = room(ai, me);
+                move_undo();
+                if (r < worst) {
+                    worst = r;
+                }
+            }
+            // else the opponent crashes: no reply to fear
+            unsigned long now = region_upkeep();
+            add_work(ai, now - ai->upkeep);
+            ai->upkeep = now;
+        }
+        move_undo();
+        if (!ai->timedOut || worst <= best) {
+            score[a] = worst;
+            if (worst > best) {
+                best = worst;
+            }
+        }
+    }
+    unsigned long now = region_upkeep();
+    add_work(ai, now - ai->upkeep);
+    ai->upkeep = now;
+    // the opponent's computer player did not make these moves
+    aiState[get_game()][you->entity - CELL_P0].upkeep += now - upkeep;
+
+    int n = 0;
+    for (int i = 0; i < *numMatches; i++) {
+        int s = score[rules[matches[i]].action];
+        if (s < 0 || s >= best || s > cutoff) {
+            matches[n++] = matches[i];
+        }
+    }
+    if (n > 0) {
+        *numMatches = n;
+    }
+    dprintf("lookahead: forward=%d left=%d right=%d; %d rules left\n",
+            score[MoveForward], score[MoveLeft], score[MoveRight],
+            *numMatches);
+}
+
+
+/* The opponent model's prediction is used if it is based on at least
+ * this many observations and has at least this probability. */
+#define PREDICT_MIN_OBSERVATIONS 8
+#define PREDICT_MIN_PROB (OPP_ONE * 6 / 10)
+
+/*
+ * Learn from the opponent's last move, and predict its next one. If the
+ * prediction is good enough, the search treats the cell the opponent is
+ * going to move to as occupied; i.e. unlikely replies are pruned.
+ */
+static void
+predict_opponent(ai_state_t* ai, player_t* you) {
+    opp_model_observe(you);
+    int probs[OPP_ACTIONS];
+    int n = opp_model_predict(you, probs);
+    int best = MoveForward;
+    for (int a = 0; a < OPP_ACTIONS; a++) {
+        if (probs[a] > probs[best]) {
+            best = a;
+        }
+    }
+    ai->hasPrediction = n >= PREDICT_MIN_OBSERVATIONS
+                     && probs[best] >= PREDICT_MIN_PROB;
+    if (ai->hasPrediction) {
+        ai->predicted = get_newpos(you->pos, you->direction, best);
+    }
+    dprintf("opponent model: forward=%d left=%d right=%d (n=%d)%s\n",
+            probs[MoveForward], probs[MoveLeft], probs[MoveRight], n,
+            ai->hasPrediction ? " *used*" : "");
+}
+
+
+/*
+ * Pseudo random number generator (xorshift). Every player has its own
+ * state, so that a game can be replayed given the initial states.
+ */
+static uint32_t
+next_random(uint32_t* state) {
+    uint32_t x = *state ? *state : 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+
 /*
  * Pick one rule from the list of rules in matches[]
  */
 static action_t
-get_action(int* matches, int numMatches) {
+get_action(int* matches, int numMatches, uint32_t* rng) {
     assert(numMatches < RULES_LEN);
     assert(numMatches > 0);
 
@@ -380,7 +922,7 @@ get_action(int* matches, int numMatches) {
     for (int i = 0; i < numMatches; i++) {
         totalWeight += rules[matches[i]].weight;
     }
-    int selected = random() % totalWeight;
+    int selected = next_random(rng) % totalWeight;
 
     int i;
     for(i = 0; i < numMatches; i++) {
@@ -396,41 +938,333 @@ get_action(int* matches, int numMatches) {
 }
 
 
+/*
+ * Size of the arena: all per-move data of the AI, that is, the flood fill
+ * stack and the queue of blocks (see get_computer_move()). The arena is
+ * reserved once and reset for every move. The stack comes first; its
+ * entries are 8 bytes, the arena's alignment, so the queue needs no
+ * padding.
+ */
+static size_t
+arena_size() {
+    return numCellsX * numCellsY * sizeof(coord_t)
+            + block_count(0) * sizeof(int);
+}
+
+
 /*
  * Called at the beginning of a new single player game.
+ * The caller seeds the players' random number generators (player_t.rng).
  */
 void
 init_computer_move() {
+    int numCells = numCellsX * numCellsY;
+    ai_state_t* state = aiState[get_game()];
+    if (state[0].visited == NULL) {
+        if (numRules == 0) {
+            init_rules();
+        }
+        // the cutoff of the level, unless the level has been set already
+        set_computer_level(aiLevel);
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            ai_state_t* ai = &state[i];
+            arena_init(&ai->arena, alloc_pages(arena_size()), arena_size());
+            ai->visited = alloc_pages(numCells * sizeof(uint32_t));
+            for (int l = 0; l < BLOCK_LEVELS; l++) {
+                ai->blockVisited[l] =
+                        alloc_pages(block_count(l) * sizeof(uint32_t));
+            }
+        }
+    } else {
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            dprintf("AI memory (player %d): high-water mark %u of %u "
+                    "bytes\n", i, (unsigned)state[i].arena.highwater,
+                    (unsigned)state[i].arena.size);
+        }
+    }
+    forget_computer_upkeep();
+    opp_model_newgame();
+}
+
+
+/*
+ * Do not charge the next moves of the computer players for keeping the
+ * region sizes up to date for what is on the board now: it was set up
+ * rather than played (e.g. a benchmark position), or belongs to an
+ * earlier game.
+ */
+void
+forget_computer_upkeep() {
+    ai_state_t* state = aiState[get_game()];
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        state[i].upkeep = region_upkeep();
+    }
+}
+
+
+/*
+ * Set the difficulty level of the computer players (0 ... AI_LEVELS - 1;
+ * see aiLevels). Call only while no AI is searching.
+ */
+void
+set_computer_level(int level) {
+    assert(0 <= level && level < AI_LEVELS);
+    aiLevel = level;
+    cutoff = aiLevels[level].cutoff ? aiLevels[level].cutoff : defaultCutoff;
+}
+
+
+int
+get_computer_level() {
+    return aiLevel;
+}
+
+
+const char*
+get_computer_level_name(int level) {
+    return aiLevels[level].name;
+}
+
+
+/*
+ * Whether the moves at "level" depend on the speed of the machine (the
+ * level has no work budget); a game played at such a level cannot be
+ * replayed by searching again.
+ */
+int
+is_computer_level_timed(int level) {
+    return aiLevels[level].budget == 0;
+}
+
+
+/*
+ * Load rules from a text file, which replace the built-in rules. Lines
+ * starting with '#' are comments; the other lines are one of:
+ *
+ *   rule <condition> forward|left|right <weight>
+ *   cutoff <number>       (see defaultCutoff)
+ *   diff <number>         (see diff)
+ *
+ * Files like this are written by the rule tuner on the development host
+ * (tools/aitune.c). Call only while no AI is searching.
+ * @return: 0 okay; -1 format error (the rules do not change)
+ */
+int
+rules_load(const char* text, size_t size) {
+    rule_t loaded[RULES_LEN];
+    int numLoaded = 0;
+    int newCutoff = defaultCutoff;
+    int newDiff = diff;
+    size_t pos = 0;
+    int lineno = 0;
+    while (pos < size) {
+        char line[80];
+        size_t len = 0;
+        while (pos < size && text[pos] != '\n') {
+            if (len < sizeof(line) - 1) {
+                line[len++] = text[pos];
+            }
+            pos++;
+        }
+        pos++;
+        line[len] = 0;
+        lineno++;
+
+        char key[16];
+        char cond[COND_LEN + 1];
+        char action[16];
+        int value;
+        if (line[0] == '#' || sscanf(line, "%15s", key) != 1) {
+            continue;
+        }
+        if (strcmp(key, "rule") == 0
+        && sscanf(line, "rule %10s %15s %d", cond, action, &value) == 3
+        && strlen(cond) < COND_LEN && strspn(cond, "01#") == strlen(cond)
+        && value > 0 && numLoaded < RULES_LEN) {
+            int a;
+            for (a = 0; a < ActionLen; a++) {
+                if (strcmp(action, str_action[a]) == 0) {
+                    break;
+                }
+            }
+            if (a < ActionLen) {
+                rule_t* r = &loaded[numLoaded++];
+                memset(r->cond, '#', COND_LEN - 1);
+                memcpy(r->cond, cond, strlen(cond));
+                r->cond[COND_LEN - 1] = 0;
+                r->action = a;
+                r->weight = value;
+                continue;
+            }
+        } else if (sscanf(line, "cutoff %d", &value) == 1 && value > 0) {
+            newCutoff = value;
+            continue;
+        } else if (sscanf(line, "diff %d", &value) == 1 && value >= 0) {
+            newDiff = value;
+            continue;
+        }
+        printf("rules: line %d: invalid\n", lineno);
+        return -1;
+    }
+    if (numLoaded == 0) {
+        printf("rules: no rules\n");
+        return -1;
+    }
+    memcpy(rules, loaded, sizeof(loaded));
+    numRules = numLoaded;
+    defaultCutoff = newCutoff;
+    diff = newDiff;
+    set_computer_level(aiLevel);
+    return 0;
+}
+
+
+/*
+ * Write the current rules to "text" (at most "size" bytes, terminated),
+ * in the format rules_load() reads.
+ * @return: length of the text
+ */
+int
+rules_save(char* text, size_t size) {
     if (numRules == 0) {
         init_rules();
-        srandom(get_current_time());
     }
-    // reset value as variable must not overflow
-    traceValue = CELL_LEN + 1;
+    int len = snprintf(text, size, "cutoff %d\ndiff %d\n", defaultCutoff, diff);
+    for (int i = 0; i < numRules && len < (int)size; i++) {
+        char cond[COND_LEN];
+        strcpy(cond, rules[i].cond);
+        // trailing "don't care" conditions go without saying
+        for (int j = strlen(cond) - 1; j > 0 && cond[j] == '#'; j--) {
+            cond[j] = 0;
+        }
+        len += snprintf(text + len, size - len, "rule %-9s %-7s %d\n",
+                cond, str_action[rules[i].action], rules[i].weight);
+    }
+    return len < (int)size ? len : (int)size - 1;
 }
 
 
 /*
- * Main entry point of game AI.
- * @param endTime: the time computer has to decide on a move; unused at the
- *                 moment but required if one wants to include a mini-max
- *                 evaluation, for example
+ * The numbers a rule tuner may change: the weights of the rules, followed
+ * by the default cutoff and diff.
+ * @param params: receives the numbers (at most "max")
+ * @return: number of parameters
+ */
+int
+get_computer_params(int* params, int max) {
+    if (numRules == 0) {
+        init_rules();
+    }
+    assert(numRules + 2 <= max);
+    for (int i = 0; i < numRules; i++) {
+        params[i] = rules[i].weight;
+    }
+    params[numRules] = defaultCutoff;
+    params[numRules + 1] = diff;
+    return numRules + 2;
+}
+
+
+/*
+ * Set the numbers get_computer_params() returns. Call only while no AI is
+ * searching.
+ */
+void
+set_computer_params(const int* params) {
+    for (int i = 0; i < numRules; i++) {
+        rules[i].weight = params[i] > 0 ? params[i] : 1;
+    }
+    defaultCutoff = params[numRules] > 0 ? params[numRules] : 1;
+    diff = params[numRules + 1] >= 0 ? params[numRules + 1] : 0;
+    set_computer_level(aiLevel);
+}
+
+
+/*
+ * Amount of work (number of board cells visited) the AI did to decide on
+ * the last move of player "me"; a machine independent measure of the cost
+ * of a move.
+ */
+unsigned long
+get_computer_work(player_t* me) {
+    return aiState[get_game()][me->entity - CELL_P0].work;
+}
+
+
+/*
+ * Whether both computer players of the game decide on its board at the
+ * same time (AI threads; see aithread.c). They must not look ahead then,
+ * because that makes moves on the board (see look_ahead()).
+ */
+void
+share_computer_board(int shared) {
+    boardShared[get_game()] = shared;
+}
+
+
+/*
+ * Main entry point of game AI. The AI leaves the board as it was (it only
+ * makes moves on it to look ahead, and only if the board is not shared;
+ * see share_computer_board()), and the AIs of different players share no
+ * state (apart from the read-only rules), so both players' moves can be
+ * computed at the same time.
+ * @param endTime: the time computer has to decide on a move; at level 0,
+ *                 the search is cut short when it takes longer
  * @param me: the current, computer player
  * @param you: the other player (human or other computer)
  */
 direction_t
 get_computer_move(uint64_t endTime, player_t* me, player_t* you) {
-    static char msg[COND_LEN];
-    read_detectors(msg, me, you);
+    ai_state_t* ai = &aiState[get_game()][me->entity - CELL_P0];
+    char msg[COND_LEN];
+
+    // everything allocated during the previous move is released here
+    arena_reset(&ai->arena);
+    ai->work = 0;
+    ai->endTime = endTime;
+    ai->timedOut = 0;
+    ai->fillStack = arena_alloc(&ai->arena,
+            numCellsX * numCellsY * sizeof(coord_t));
+    assert(ai->fillStack != NULL);
+    ai->blockQueue = arena_alloc(&ai->arena, block_count(0) * sizeof(int));
+    assert(ai->blockQueue != NULL);
+
+    // the region sizes the search looks up were paid for when the moves
+    // since the last one were put on the board
+    unsigned long upkeep = region_upkeep();
+    if (aiLevels[aiLevel].regions) {
+        add_work(ai, upkeep - ai->upkeep);
+    }
+    ai->upkeep = upkeep;
+
+    predict_opponent(ai, you);
+
+    // early in a round, the move may be in the opening book
+    int bookdir = aiLevels[aiLevel].book ? book_lookup(me, you) : -1;
+    for (action_t a = MoveForward; a < ActionLen && bookdir >= 0; a++) {
+        if (get_direction(me->direction, a) == (direction_t)bookdir
+        && isempty_cell(get_newpos(me->pos, me->direction, a))) {
+            dprintf("computer moves %d (%s; book)\n", bookdir,
+                    str_direction[bookdir]);
+            return bookdir;
+        }
+    }
+
+    int counts[ActionLen];
+    read_detectors(ai, msg, me, you, counts);
 
     int matches[RULES_LEN];
     int numMatches;
     match_rules(msg, matches, &numMatches);
+    prune_rules(me, you, counts, matches, &numMatches);
+    look_ahead(ai, me, you, matches, &numMatches);
 
-    action_t action = get_action(matches, numMatches);
+    action_t action = get_action(matches, numMatches, &me->rng);
 
     direction_t newdir = get_direction(me->direction, action);
     dprintf("computer moves %d (%s)\n", newdir, str_direction[newdir]);
+    dprintf("arena: %u bytes used; high-water mark %u\n",
+            (unsigned)ai->arena.used, (unsigned)ai->arena.highwater);
     dprintf("--------------------\n");
     return newdir;
 }
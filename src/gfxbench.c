@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Microbenchmarks of the drawing functions in graphics.c, in TSC cycles.
+ * The same code runs on the target, against the mapped frame buffer (see
+ * CONFIG_APP_TRON_GFX_BENCH), and on the development host, against a
+ * frame buffer in RAM (see tools/gfxcheck.c), so the numbers compare.
+ *
+ * Each primitive is run over the sizes the game draws: trail segments
+ * and cells of the board, the whole screen, and the images of the start
+ * and the game over screens. For each, the table shows cycles per pixel
+ * and bytes written per cycle (4 bytes per pixel).
+ */
+
+#include <stdio.h>
+#include "tron.h"
+#include "graphics.h"
+#include "gfxbench.h"
+
+/* the images drawn; see images/ */
+typedef struct {
+    const char* name;
+    int w;
+    int h;
+} sprite_t;
+
+static const sprite_t title = { "title.ppm", 197, 42 };
+static const sprite_t banner = { "player0wins.ppm", 200, 60 };
+
+/* opacities the banner is blended at */
+static const float opacities[] = { 0.25, 0.5, 0.75 };
+
+/* keeps gfx_map_color() from being optimized away */
+static volatile uint32_t sink;
+
+
+static void
+report(const char* name, int w, int h, long count, uint64_t cycles) {
+    char size[16];
+    snprintf(size, sizeof(size), "%dx%d", w, h);
+    double pixels = (double)w * h * count;
+    printf("%-28s %10s %10.2f %10.2f\n", name, size,
+            pixels ? cycles / pixels : 0,
+            cycles ? pixels * 4 / cycles : 0);
+}
+
+
+/*
+ * Draw count rectangles of w x h pixels spread over the board.
+ */
+static uint64_t
+bench_rect(int w, int h, long count) {
+    uint64_t start = read_tsc();
+    for (long i = 0; i < count; i++) {
+        int x = (int)((i * 7919L) % (XRES - w));
+        int y = (int)((i * 104729L) % (YRES - h));
+        gfx_draw_rect(x, y, w, h, (uint32_t)i);
+    }
+    return read_tsc() - start;
+}
+
+
+/*
+ * Display image s count times.
+ */
+static uint64_t
+bench_ppm(const sprite_t* s, float opacity, long count) {
+    // the first call decodes the image
+    gfx_diplay_ppm(0, 0, s->name, opacity);
+    uint64_t start = read_tsc();
+    for (long i = 0; i < count; i++) {
+        int x = (int)((i * 7919L) % (XRES - s->w));
+        int y = (int)((i * 104729L) % (YRES - s->h));
+        gfx_diplay_ppm(x, y, s->name, opacity);
+    }
+    return read_tsc() - start;
+}
+
+
+/*
+ * Run all benchmarks on a screen of width x height pixels, and print a
+ * table of the results. Call after init_board(); this draws over the
+ * whole screen.
+ */
+void
+gfx_bench(int width, int height) {
+    const int lw = cellWidth + lineWidth;
+    uint64_t c;
+
+    printf("=== graphics benchmark (screen %dx%d) ===\n", width, height);
+    printf("%-28s %10s %10s %10s\n", "function", "size", "cycles/px",
+            "bytes/cyc");
+
+    const long rects = 100000;
+    c = bench_rect(lw, lineWidth, rects);
+    report("gfx_draw_rect (trail, h)", lw, lineWidth, rects, c);
+    c = bench_rect(lineWidth, lw, rects);
+    report("gfx_draw_rect (trail, v)", lineWidth, lw, rects, c);
+    c = bench_rect(cellWidth, cellWidth, rects);
+    report("gfx_draw_rect (cell)", cellWidth, cellWidth, rects, c);
+
+    const long screens = 20;
+    c = read_tsc();
+    for (long i = 0; i < screens; i++) {
+        gfx_fill_screen((uint32_t)i);
+    }
+    c = read_tsc() - c;
+    report("gfx_fill_screen", width, height, screens, c);
+
+    const long images = 2000;
+    c = bench_ppm(&title, 1, images);
+    report("gfx_diplay_ppm (opaque)", title.w, title.h, images, c);
+    for (int i = 0; i < sizeof(opacities) / sizeof(opacities[0]); i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "gfx_diplay_ppm (blend %.2f)",
+                opacities[i]);
+        c = bench_ppm(&banner, opacities[i], images);
+        report(name, banner.w, banner.h, images, c);
+    }
+
+    const long colors = 1000000;
+    c = read_tsc();
+    for (long i = 0; i < colors; i++) {
+        sink = gfx_map_color(i, i >> 8, i >> 16);
+    }
+    c = read_tsc() - c;
+    printf("%-28s %10s %10.2f cycles/call\n", "gfx_map_color", "",
+            (double)c / colors);
+
+    const long frames = 10000;
+    c = read_tsc();
+    for (long i = 0; i < frames; i++) {
+        // a typical tick: two players move
+        gfx_draw_rect(i % (XRES - lw), cellWidth, lw, lineWidth, i);
+        gfx_draw_rect(cellWidth, i % (YRES - lw), lineWidth, lw, i);
+        gfx_present();
+    }
+    c = read_tsc() - c;
+    printf("%-28s %10s %10.0f cycles/frame\n", "gfx_present (tick)", "",
+            (double)c / frames);
+    printf("=== graphics benchmark end ===\n");
+}
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef GFXBENCH_H_
+#define GFXBENCH_H_
+
+void gfx_bench(int width, int height);
+
+
+#endif /* GFXBENCH_H_ */
@@ -13,16 +13,64 @@
  * a 32 bits per pixel memory layout (direct color RGB memory model).
  */
 
+#include <autoconf.h>
 #include <string.h>
+#include <assert.h>
+#include <sel4/sel4.h>
 #include <cpio/cpio.h>
 #include "graphics.h"
+#include "tron.h"
 
 /* pointer to base address of (linear) frame buffer */
 typedef uint32_t* fb_t;
 
 static seL4_VBEModeInfoBlock mib;
+
+/* where all drawing goes: the frame buffer itself, or, with page flipping,
+ * a copy of the screen in normal (cached) memory; gfx_present() copies
+ * what changed to the hidden page of video memory and then shows it */
 static fb_t fb = NULL;
 
+/* the (linear) frame buffer in video memory: numPages screens, one
+ * below the other; backPage is the one not shown */
+static fb_t vram = NULL;
+static int numPages = 1;
+static int backPage = 0;
+
+/* number of pixels from one scan line to the next (may exceed xRes) */
+static int pitch;
+
+/* Bochs VBE extensions ("dispi"), as emulated by QEMU and Bochs */
+#define DISPI_IOPORT_INDEX 0x01ce
+#define DISPI_IOPORT_DATA  0x01cf
+#define DISPI_INDEX_ID          0x0
+#define DISPI_INDEX_VIRT_HEIGHT 0x7
+#define DISPI_INDEX_Y_OFFSET    0x9
+#define DISPI_ID0 0xb0c0
+#define DISPI_ID5 0xb0c5
+
+/* VGA input status register 1: bit 3 is set during the vertical retrace */
+#define VGA_INPUT_STATUS 0x03da
+#define VGA_VRETRACE     0x08
+
+/* port reads to wait for the vertical retrace at most; a little more than
+ * a frame at 60 Hz, at roughly a microsecond per read */
+#define VRETRACE_POLLS 20000
+
+static ps_io_port_ops_t* portOps = NULL;
+
+/* Rectangles drawn to since the last gfx_present() (dirty[cur]), and
+ * in the frame before (dirty[!cur]); the hidden page lacks both. When a
+ * list runs full, its last rectangle grows to cover the others. */
+typedef struct {
+    int x0, y0, x1, y1;
+} rect_t;
+
+#define MAX_DIRTY 32
+static rect_t dirty[2][MAX_DIRTY];
+static int numDirty[2];
+static int cur = 0;
+
 /* linked in via archive.o; see Makefile */
 extern char _cpio_archive[];
 
@@ -31,30 +79,245 @@ void
 gfx_init_IA32BootInfo(seL4_IA32_BootInfo* bootinfo) {
     mib = bootinfo->vbeModeInfoBlock;
     assert(mib.bitsPerPixel == 32);
+    /* linBytesPerScanLine is VBE 3.0+ */
+    pitch = (mib.linBytesPerScanLine ? mib.linBytesPerScanLine
+                                     : mib.bytesPerScanLine) / 4;
+}
+
+
+static uint16_t
+dispi_read(uint16_t index) {
+    uint32_t value = 0;
+    ps_io_port_out(portOps, DISPI_IOPORT_INDEX, 2, index);
+    ps_io_port_in(portOps, DISPI_IOPORT_DATA, 2, &value);
+    return value;
+}
+
+
+static void
+dispi_write(uint16_t index, uint16_t value) {
+    ps_io_port_out(portOps, DISPI_IOPORT_INDEX, 2, index);
+    ps_io_port_out(portOps, DISPI_IOPORT_DATA, 2, value);
+}
+
+
+static int
+in_vretrace() {
+    uint32_t status = 0;
+    ps_io_port_in(portOps, VGA_INPUT_STATUS, 1, &status);
+    return (status & VGA_VRETRACE) != 0;
+}
+
+
+/*
+ * Wait for the start of the vertical retrace, so that a flip takes effect
+ * between two frames instead of in the middle of one. Gives up after
+ * VRETRACE_POLLS reads, e.g. if the card does not report the retrace.
+ */
+static void
+wait_vretrace() {
+    static int warned = 0;
+    int polls = 0;
+    // a retrace that has begun already may end before the flip
+    while (in_vretrace() && polls < VRETRACE_POLLS) {
+        polls++;
+    }
+    while (!in_vretrace() && polls < VRETRACE_POLLS) {
+        polls++;
+    }
+    if (polls == VRETRACE_POLLS && !warned) {
+        printf("page flipping: no vertical retrace; flips may tear\n");
+        warned = 1;
+    }
+}
+
+
+int
+gfx_init_page_flip(ps_io_port_ops_t* ops) {
+    portOps = ops;
+    // the mode has to have room for a second image, and we need a way to
+    // tell the card which image to show: only the Bochs interface can be
+    // used from here (the VBE protected mode interface is 16 bit code)
+    uint16_t id = dispi_read(DISPI_INDEX_ID);
+    if (mib.linImagePages < 1 || id < DISPI_ID0 || id > DISPI_ID5) {
+        printf("page flipping: not supported (images %d, dispi id 0x%x)\n",
+                mib.linImagePages + 1, id);
+        return 0;
+    }
+    if (dispi_read(DISPI_INDEX_VIRT_HEIGHT) < 2 * mib.yRes) {
+        printf("page flipping: not enough video memory\n");
+        return 0;
+    }
+    numPages = 2;
+    return 1;
 }
 
 
 void
 gfx_map_video_ram(ps_io_mapper_t *io_mapper) {
-    size_t size = mib.yRes * mib.linBytesPerScanLine;
-    fb = (fb_t) ps_io_map(io_mapper,
+    size_t size = mib.yRes * pitch * 4;
+    vram = (fb_t) ps_io_map(io_mapper,
             mib.physBasePtr,
-            size,
+            size * numPages,
             0,
             PS_MEM_HW);
-    assert(fb != NULL);
+    assert(vram != NULL);
+    fb = vram;
+    if (numPages > 1) {
+        fb = alloc_pages(size);
+        // show page 0, draw into page 1
+        dispi_write(DISPI_INDEX_Y_OFFSET, 0);
+        backPage = 1;
+        numDirty[0] = numDirty[1] = 0;
+    }
+}
+
+
+/*
+ * Change the memory type of the mapping of video memory; e.g.
+ * seL4_IA32_CacheDisabled or seL4_IA32_WriteCombining.
+ * @return: 0 on success
+ */
+static int
+remap_video_ram(vspace_t* vspace, int attr) {
+    size_t size = mib.yRes * pitch * 4 * numPages;
+    seL4_CPtr last = seL4_CapNull;
+    for (size_t off = 0; off < size; off += BIT(seL4_PageBits)) {
+        seL4_CPtr frame = vspace_get_cap(vspace, (char*)vram + off);
+        if (frame == seL4_CapNull) {
+            return -1;
+        }
+        if (frame == last) {
+            // a large page
+            continue;
+        }
+        int err = seL4_IA32_Page_Remap(frame, seL4_CapInitThreadPD,
+                seL4_AllRights, attr);
+        if (err != 0) {
+            return err;
+        }
+        last = frame;
+    }
+    return 0;
+}
+
+
+/*
+ * Bytes written to the visible page of video memory per 1000 TSC cycles.
+ */
+static uint64_t
+video_ram_bandwidth() {
+    const int rounds = 4;
+    size_t n = mib.yRes * pitch;
+    uint64_t start = read_tsc();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < n; i++) {
+            vram[i] = 0;
+        }
+    }
+    uint64_t cycles = read_tsc() - start;
+    return rounds * n * 4 * 1000 / (cycles ? cycles : 1);
+}
+
+
+void
+gfx_tune_video_ram(vspace_t* vspace, int selftest) {
+    assert(vram != NULL);
+    if (!selftest) {
+        if (remap_video_ram(vspace, seL4_IA32_WriteCombining) != 0) {
+            printf("video memory: write-combining not available\n");
+        }
+        return;
+    }
+    uint64_t uc = 0;
+    if (remap_video_ram(vspace, seL4_IA32_CacheDisabled) == 0) {
+        uc = video_ram_bandwidth();
+    }
+    uint64_t wc = 0;
+    if (remap_video_ram(vspace, seL4_IA32_WriteCombining) == 0) {
+        wc = video_ram_bandwidth();
+    }
+    printf("video memory: uncached %llu, write-combining %llu "
+            "bytes per 1000 cycles\n",
+            (unsigned long long)uc, (unsigned long long)wc);
+    if (wc < uc) {
+        remap_video_ram(vspace, seL4_IA32_CacheDisabled);
+    }
+}
+
+
+/*
+ * Remember that the rectangle (x, y, w, h) of the screen was drawn to.
+ */
+static void
+mark_dirty(int x, int y, int w, int h) {
+    if (numPages < 2 || w <= 0 || h <= 0) {
+        return;
+    }
+    rect_t r = {x, y, x + w, y + h};
+    if (numDirty[cur] == MAX_DIRTY) {
+        rect_t* last = &dirty[cur][MAX_DIRTY - 1];
+        last->x0 = r.x0 < last->x0 ? r.x0 : last->x0;
+        last->y0 = r.y0 < last->y0 ? r.y0 : last->y0;
+        last->x1 = r.x1 > last->x1 ? r.x1 : last->x1;
+        last->y1 = r.y1 > last->y1 ? r.y1 : last->y1;
+    } else {
+        dirty[cur][numDirty[cur]++] = r;
+    }
+}
+
+
+void
+gfx_present() {
+    gfx_present_copy();
+    gfx_present_flip();
+}
+
+
+void
+gfx_present_copy() {
+    if (numPages < 2) {
+        return;
+    }
+    // bring the hidden page up to date: it misses this frame's and the
+    // previous frame's drawing
+    fb_t back = vram + backPage * mib.yRes * pitch;
+    for (int k = 0; k < 2; k++) {
+        for (int i = 0; i < numDirty[k]; i++) {
+            const rect_t* r = &dirty[k][i];
+            for (int y = r->y0; y < r->y1; y++) {
+                memcpy(back + y * pitch + r->x0, fb + y * pitch + r->x0,
+                        (r->x1 - r->x0) * sizeof(uint32_t));
+            }
+        }
+    }
+    // whatever is drawn from now on goes into the next frame
+    cur = 1 - cur;
+    numDirty[cur] = 0;
+}
+
+
+void
+gfx_present_flip() {
+    if (numPages < 2) {
+        return;
+    }
+    wait_vretrace();
+    dispi_write(DISPI_INDEX_Y_OFFSET, backPage * mib.yRes);
+    backPage = 1 - backPage;
 }
 
 
 void
 gfx_display_testpic() {
     assert(fb != NULL);
-    const size_t size = mib.yRes * mib.linBytesPerScanLine;
+    const size_t size = mib.yRes * pitch * 4;
     for (int i = 0; i < size / 4; i++) {
         /* set pixel;
          * depending on color depth, one pixel is 1, 2, or 3 bytes */
         fb[i] = i; //generates some pattern
     }
+    mark_dirty(0, 0, mib.xRes, mib.yRes);
 }
 
 
@@ -146,26 +409,47 @@ gfx_map_color(uint8_t r, uint8_t g, uint8_t b) {
 
 inline static void
 gfx_draw_point(const int x, const int y, const uint32_t c) {
-    fb[y * mib.xRes + x] = c;
+    fb[y * pitch + x] = c;
 }
 
 
 inline static uint32_t
 gfx_get_point(const int x, const int y) {
-    return fb[y * mib.xRes + x];
+    return fb[y * pitch + x];
 }
 
 
 void
 gfx_draw_rect(const int x, const int y, const int w , const int h, uint32_t c) {
-    for (int i = 0; i < w; i++) {
-        for (int j = 0; j < h; j++) {
-            gfx_draw_point(x + i, y + j, c);
+    mark_dirty(x, y, w, h);
+    // row by row, so that we write to consecutive addresses
+    for (int j = 0; j < h; j++) {
+        fb_t row = fb + (y + j) * pitch + x;
+        for (int i = 0; i < w; i++) {
+            row[i] = c;
         }
     }
 }
 
 
+void
+gfx_save_rect(const int x, const int y, const int w, const int h, uint32_t* buf) {
+    for (int j = 0; j < h; j++) {
+        memcpy(buf + j * w, fb + (y + j) * pitch + x, w * sizeof(uint32_t));
+    }
+}
+
+
+void
+gfx_restore_rect(const int x, const int y, const int w, const int h,
+        const uint32_t* buf) {
+    mark_dirty(x, y, w, h);
+    for (int j = 0; j < h; j++) {
+        memcpy(fb + (y + j) * pitch + x, buf + j * w, w * sizeof(uint32_t));
+    }
+}
+
+
 void
 gfx_fill_screen(uint32_t c) {
     gfx_draw_rect(0, 0, mib.xRes, mib.yRes, c);
@@ -173,14 +457,36 @@ gfx_fill_screen(uint32_t c) {
 
 
 /*
- * "Load" a PPM image from the cpio archive and display it on the screen
- * at location (startx, starty) with given opacity level.
+ * A decoded image: pixels in frame buffer format, row after row.
+ */
+typedef struct {
+    char name[32];
+    int w;
+    int h;
+    uint32_t* pixels;
+} image_t;
+
+/* images are decoded the first time they are displayed, and kept */
+#define MAX_IMAGES 8
+static image_t images[MAX_IMAGES];
+static int numImages = 0;
+
+
+/*
+ * Get image "filename" from the cache, or decode the PPM file from the
+ * cpio archive into the cache.
  * See https://en.wikipedia.org/wiki/Netpbm_format for PPM format.
  */
-void
-gfx_diplay_ppm(uint32_t startx, uint32_t starty, const char* filename, float opacity) {
-    assert(filename);
-    assert(opacity >= 0 && opacity <= 1.0);
+static image_t*
+get_image(const char* filename) {
+    for (int i = 0; i < numImages; i++) {
+        if (strcmp(images[i].name, filename) == 0) {
+            return &images[i];
+        }
+    }
+    assert(numImages < MAX_IMAGES);
+    assert(strlen(filename) < sizeof(images[0].name));
+
     unsigned long filesize;
     void * img = cpio_get_file(_cpio_archive, filename, &filesize);
     assert(img);
@@ -197,26 +503,61 @@ gfx_diplay_ppm(uint32_t startx, uint32_t starty, const char* filename, float opa
     // skip over separator
     src += 5;
 
-    //copy pixels to frame buffer
-    for (int y = 0; y < imgy; y++) {
-        for (int x = 0; x < imgx; x++) {
-            uint8_t r = *src++;
-            uint8_t g = *src++;
-            uint8_t b = *src++;
-
-            if (opacity < 1.0) {
-                uint32_t backgrnd = gfx_get_point(startx + x, starty + y);
-                uint8_t r2 = (backgrnd & 0xFF0000) >> 16;
-                uint8_t g2 = (backgrnd & 0xFF00) >> 8;
-                uint8_t b2 = (backgrnd & 0xFF);
-
-                r = r * opacity + r2 * (1.0 - opacity);
-                g = g * opacity + g2 * (1.0 - opacity);
-                b = b * opacity + b2 * (1.0 - opacity);
-            }
+    image_t* image = &images[numImages++];
+    strcpy(image->name, filename);
+    image->w = imgx;
+    image->h = imgy;
+    image->pixels = alloc_pages(imgx * imgy * sizeof(uint32_t));
+    for (int i = 0; i < imgx * imgy; i++) {
+        image->pixels[i] = gfx_map_color(src[0], src[1], src[2]);
+        src += 3;
+    }
+    return image;
+}
+
+
+/*
+ * Display PPM image "filename" from the cpio archive on the screen
+ * at location (startx, starty) with given opacity level.
+ */
+void
+gfx_diplay_ppm(uint32_t startx, uint32_t starty, const char* filename, float opacity) {
+    assert(filename);
+    assert(opacity >= 0 && opacity <= 1.0);
+    image_t* image = get_image(filename);
+
+    if (opacity == 1.0) {
+        gfx_restore_rect(startx, starty, image->w, image->h, image->pixels);
+        return;
+    }
+
+    //blend pixels with the frame buffer
+    mark_dirty(startx, starty, image->w, image->h);
+    const uint32_t* src = image->pixels;
+    for (int y = 0; y < image->h; y++) {
+        for (int x = 0; x < image->w; x++) {
+            uint32_t pixel = *src++;
+            uint8_t r = pixel >> mib.linRedOff;
+            uint8_t g = pixel >> mib.linGreenOff;
+            uint8_t b = pixel >> mib.linBlueOff;
+
+            uint32_t backgrnd = gfx_get_point(startx + x, starty + y);
+            uint8_t r2 = backgrnd >> mib.linRedOff;
+            uint8_t g2 = backgrnd >> mib.linGreenOff;
+            uint8_t b2 = backgrnd >> mib.linBlueOff;
+
+            r = r * opacity + r2 * (1.0 - opacity);
+            g = g * opacity + g2 * (1.0 - opacity);
+            b = b * opacity + b2 * (1.0 - opacity);
 
             uint32_t color = gfx_map_color(r, g, b);
             gfx_draw_point(startx + x, starty + y, color);
         }
     }
 }
+
+
+void
+gfx_load_ppm(const char* filename) {
+    get_image(filename);
+}
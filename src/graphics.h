@@ -13,6 +13,7 @@
 #include <stdio.h>
 #include <sel4/arch/bootinfo.h>
 #include <sel4platsupport/io.h>
+#include <vspace/vspace.h>
 
 
 
@@ -20,6 +21,15 @@ void
 gfx_init_IA32BootInfo(seL4_IA32_BootInfo* bootinfo);
 
 
+/*
+ * Check whether the graphics card can show one image while we draw the
+ * next one (page flipping); call before gfx_map_video_ram().
+ * @return: 1 if page flipping will be used
+ */
+int
+gfx_init_page_flip(ps_io_port_ops_t* ops);
+
+
 /*
  * Map complete linear frame buffer.
  */
@@ -27,6 +37,37 @@ void
 gfx_map_video_ram(ps_io_mapper_t *io_mapper);
 
 
+/*
+ * Map the frame buffer write-combining, so that consecutive writes are
+ * sent to the card in bursts. With selftest, first measure the bandwidth
+ * of the uncached and the write-combining mapping, and keep the faster.
+ */
+void
+gfx_tune_video_ram(vspace_t* vspace, int selftest);
+
+
+/*
+ * Show what has been drawn. With page flipping, nothing drawn shows up
+ * on screen before this is called; otherwise it does nothing.
+ */
+void
+gfx_present();
+
+
+/*
+ * gfx_present() in two steps, for callers that serialize drawing with a
+ * lock: gfx_present_copy() takes the frame, and is the only step that has
+ * to be serialized with drawing; gfx_present_flip() waits for the
+ * vertical retrace and shows the frame. Drawing in between goes into the
+ * next frame. Call gfx_present_flip() before the next gfx_present_copy().
+ */
+void
+gfx_present_copy();
+
+void
+gfx_present_flip();
+
+
 /*
  * Fill frame buffer with some values; i.e., display a test picture.
  * @param fb base address of frame buffer
@@ -69,6 +110,18 @@ void
 gfx_draw_rect(const int x, const int y, const int w , const int h, uint32_t c);
 
 
+/*
+ * Copy the rectangle (x, y, w, h) of the screen into buf (w * h pixels),
+ * and back onto the screen. Both copy whole rows at a time.
+ */
+void
+gfx_save_rect(const int x, const int y, const int w, const int h, uint32_t* buf);
+
+void
+gfx_restore_rect(const int x, const int y, const int w, const int h,
+        const uint32_t* buf);
+
+
 /*
  * Fill entire screen with color c.
  */
@@ -78,9 +131,17 @@ gfx_fill_screen(uint32_t c);
 
 /*
  * Load PPM file "filename" from cpio archive and display it
- * at (startx, starty) coordinate.
+ * at (startx, starty) coordinate. Each image is decoded only once, the
+ * first time it is displayed.
  */
 void
 gfx_diplay_ppm(uint32_t startx, uint32_t starty, const char* filename, float transp);
 
+
+/*
+ * Decode PPM file "filename" into the image cache without displaying it.
+ */
+void
+gfx_load_ppm(const char* filename);
+
 #endif /* GRAPHICS_H_ */
@@ -19,12 +19,27 @@
 #include <sel4platsupport/plat/timer.h>
 #include <sel4platsupport/arch/io.h>
 #include <sel4utils/vspace.h>
-#include <sel4utils/stack.h>
+#include <utils/stack.h>
 #include <simple-stable/simple-stable.h>
+#include <cpio/cpio.h>
 
 #include "tron.h"
+#include "board.h"
 #include "graphics.h"
 #include "inputqueue.h"
+#include "replay.h"
+#include "evaluate.h"
+#include "aithread.h"
+#include "bootprof.h"
+#include "render.h"
+#include "netplay.h"
+#include "book.h"
+#include "gfxbench.h"
+#include "memstat.h"
+#include "sched.h"
+#include "multiboard.h"
+#include "aidomain.h"
+#include "aiprocess.h"
 
 /*
  * Lots of global variables here, but at least they are all static. I tried
@@ -72,6 +87,9 @@ static vka_object_t timer_aep;
 /* input character device (e.g. keyboard, COM1) */
 static ps_chardevice_t inputdev;
 
+/* linked in via archive.o; see Makefile */
+extern char _cpio_archive[];
+
 // ======================================================================
 
 /* possible moves */
@@ -83,11 +101,39 @@ direction_t dir_back[] = { East, South, West, North};
 /* mappings from keyboard keys into dir_forward[] for the two players */
 static char *keymap[] = { "jilk", "awds"};
 
+/* turbo keys of the two players */
+static char turbokey[] = { 'o', 'q' };
+
 /* speed in cells per second */
 static int speed = 10;
 
-/* the board is made of cells; cell coordinate (0,0) is in top left corner */
-cell_t board[numCellsX][numCellsY];
+/* A tick (1 / speed seconds) is divided into TICK_PARTS parts: a player
+ * in turbo mode moves one cell per part, otherwise one cell per tick.
+ * See run_game(). */
+#define TICK_PARTS 2
+
+/* length of a turbo boost, and the time from the start of one to the
+ * start of the next (ticks) */
+#define TURBO_TICKS 20
+#define TURBO_COOLDOWN 50
+
+/* longest time the timer hardware can be armed for (the PIT's limit is
+ * about 55 ms) */
+#define MAX_ONESHOT (50 * NS_IN_MS)
+
+/* time between frames in multi-board mode */
+#define MULTIBOARD_FRAME (40 * NS_IN_MS)
+
+/* width of a cell in pixels (see Kconfig) */
+#ifdef CONFIG_APP_TRON_CELL_WIDTH
+#define CELL_WIDTH CONFIG_APP_TRON_CELL_WIDTH
+#else
+#define CELL_WIDTH 10
+#endif
+
+/* cell geometry; see tron.h and init_board() */
+int cellWidth = CELL_WIDTH;
+int lineWidth;
 
 /* game state of players */
 player_t players[NUMPLAYERS];
@@ -96,6 +142,25 @@ static player_t* p1 = players + 1;
 
 /* amount of information printed: 0...no extra logging */
 static int loglevel = 0;
+
+/* key presses handle_user_input() has not acted on yet */
+static int pendingCancel = 0;
+static int pendingPause = 0;
+static int pendingTurbo[NUMPLAYERS];
+
+/* turbo boost of each player: ends at, and may start again at (parts of
+ * ticks; see run_game()) */
+static int turboEnd[NUMPLAYERS];
+static int turboNext[NUMPLAYERS];
+
+/* number of human players in the current game (keyboard input) */
+static int numHumanPlayers = 0;
+
+/* set while AI threads search (they run poll_during_search()) */
+static int aiThreadsBusy = 0;
+
+/* run_game() modes: play a new game or play back the last recorded game */
+enum { PLAY_GAME, PLAY_REPLAY, PLAY_REPLAY_FAST };
 // ======================================================================
 
 
@@ -104,6 +169,12 @@ static int loglevel = 0;
  */
 int
 get_loglevel() {
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+    // the AI domain has no capability to print with
+    if (get_game() == AI_DOMAIN_GAME) {
+        return 0;
+    }
+#endif
     return loglevel;
 }
 
@@ -129,11 +200,13 @@ setup_system()
 
     /* create an allocator */
     allocman_t *allocman;
+    memstat_paint("allocator pool", memPool, POOL_SIZE);
     allocman = bootstrap_use_current_simple(&simple, POOL_SIZE, memPool);
     assert(allocman);
 
     /* create a VKA */
     allocman_make_vka(&vka, allocman);
+    memstat_wrap_vka(&vka);
 
     /* create a vspace */
     UNUSED int err;
@@ -160,6 +233,50 @@ setup_system()
 }
 
 
+/*
+ * Allocate "size" bytes of (zeroed) memory from the root task's vspace.
+ * The memory stays mapped for the lifetime of the game.
+ */
+void*
+alloc_pages(size_t size) {
+    int numPages = (size + BIT(seL4_PageBits) - 1) / BIT(seL4_PageBits);
+    void* vaddr = vspace_new_pages(&vspace, seL4_AllRights, numPages,
+            seL4_PageBits);
+    assert(vaddr != NULL);
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+    // the memory of the AI domain's game is the process's (see aidomain.c)
+    if (get_game() == AI_DOMAIN_GAME) {
+        ai_process_map(vaddr, numPages);
+    }
+#endif
+    return vaddr;
+}
+
+
+/*
+ * Choose the board dimensions based on the screen resolution and the cell
+ * width, and allocate the board.
+ */
+static void
+init_board() {
+    int xres = MIN_XRES;
+    int yres = MIN_YRES;
+#ifdef CONFIG_APP_TRON_NATIVE_RES
+    xres = bootinfo2->vbeModeInfoBlock.xRes;
+    yres = bootinfo2->vbeModeInfoBlock.yRes;
+#endif
+    // about 60% of the cell width; must be an even number
+    lineWidth = (cellWidth * 6 / 10) & ~1;
+    if (lineWidth < 2) {
+        lineWidth = 2;
+    }
+
+    board_init(xres / cellWidth, yres / cellWidth);
+    printf("board: %d x %d cells (cell width %d pixels)\n",
+            numCellsX, numCellsY, cellWidth);
+}
+
+
 static void
 init_timers()
 {
@@ -211,6 +328,27 @@ get_current_time() {
 }
 
 
+/*
+ * Sleep until "time" (see get_current_time()): arm the timer for the time
+ * left, in steps the hardware can do.
+ */
+static void
+wait_until(uint64_t time) {
+    for (;;) {
+        uint64_t now = get_current_time();
+        if (now >= time) {
+            return;
+        }
+        uint64_t ns = time - now;
+        UNUSED int err = timer_oneshot_relative(timer->timer,
+                ns < MAX_ONESHOT ? ns : MAX_ONESHOT);
+        assert(err == 0);
+        seL4_Wait(timer_aep.cptr, NULL);
+        sel4_timer_handle_single_irq(timer);
+    }
+}
+
+
 /*
  * We have to loop a couple of time because we exceed hardware limit.
  */
@@ -236,45 +374,37 @@ init_cdev (enum chardev_id id,  ps_chardevice_t* dev) {
 
 
 /*
- * Check if use input occurred.
+ * Read all pending keyboard input. Direction keys go into the players'
+ * input queues; ESC and SPACE are remembered until handle_user_input()
+ * acts on them. This is also called while the AI is searching (see
+ * poll_during_search()), so that key presses are neither delayed nor lost
+ * when a search takes long.
  * @param numHumanPlayers: 1...single player game; 2..two players
- * @return: 1...cancel game; 0...continue game
  */
-static int
-handle_user_input(int numHumanPlayers) {
+static void
+read_user_input(int numHumanPlayers) {
     for (;;) { // (1)
         int c = ps_cdev_getchar(&inputdev);
         switch (c) {
         case EOF:
             //read till we get EOF
-            for (int pl = 0; pl < numHumanPlayers; pl++) {
-                int newdir;
-                while ((newdir = get_nextdir(pl)) >= 0) {
-                    // skip over forward and backward moves
-                    if (newdir != players[pl].direction
-                    && newdir !=  dir_back[players[pl].direction]) {
-                        players[pl].direction = newdir;
-                        break;
-                    }
-                }
-            }
-            return 0; // DONE <==
+            return; // DONE <==
         case 27:
             // ESC key was pressed - quit game
-            return 1;
+            pendingCancel = 1;
+            return;
         case 'm':
             loglevel = (loglevel + 1) % 2;
             break;
         case ' ':
-            printf("-- PAUSE --\n");
-            while (' ' != ps_cdev_getchar(&inputdev)) {
-                // busy waiting (see the "seL4Examples" repo for example
-                // programs that wait for interrupt)
-            }
-            break;
+            pendingPause = 1;
+            return;
         default:
             // demultiplex input: check for all players
             for (int pl = 0; pl < numHumanPlayers; pl++) {
+                if (c == turbokey[pl]) {
+                    pendingTurbo[pl] = 1;
+                }
                 // check all directions
                 for (int dir = 0; dir < DirLength; dir++) {
                     if (c == keymap[pl][dir]) {
@@ -290,50 +420,105 @@ handle_user_input(int numHumanPlayers) {
 
 
 /*
- * Map cell "element" to a color.
+ * Check if use input occurred.
+ * @param numHumanPlayers: 1...single player game; 2..two players
+ * @param due: bit i is set if player i moves next; the others keep their
+ *        direction (and input) until they move
+ * @return: 1...cancel game; 0...continue game
  */
-static int32_t
-map_color(cell_t element) {
-    uint32_t colors[] = {0
-            , gfx_map_color(0, 200, 0)
-            , gfx_map_color(0, 0, 200)
-            , gfx_map_color(200, 0, 0)};
-    return colors[element];
+static int
+handle_user_input(int numHumanPlayers, int due) {
+    read_user_input(numHumanPlayers);
+    if (pendingPause) {
+        pendingPause = 0;
+        printf("-- PAUSE --\n");
+        while (' ' != ps_cdev_getchar(&inputdev)) {
+            // busy waiting (see the "seL4Examples" repo for example
+            // programs that wait for interrupt)
+        }
+    }
+    if (pendingCancel) {
+        pendingCancel = 0;
+        return 1;
+    }
+    for (int pl = 0; pl < numHumanPlayers; pl++) {
+        if (!(due & 1 << pl)) {
+            continue;
+        }
+        int newdir;
+        while ((newdir = get_nextdir(pl)) >= 0) {
+            // skip over forward and backward moves
+            if (newdir != players[pl].direction
+            && newdir !=  dir_back[players[pl].direction]) {
+                players[pl].direction = newdir;
+                break;
+            }
+        }
+    }
+    return 0;
 }
 
 
 /*
- * Put cell element "element" onto the board, and draw it on screen.
- * This currently means to fill the cell with a unique color,
- * but this could be more elaborate...
- * @param pos: location of element
- * @param element: type of cell element (e.g. wall)
+ * Called by the game AI every now and then while it is searching: keep
+ * the keyboard drained, and tell the AI whether its time is up.
+ * @return: 1 if endTime has passed; 0 otherwise
  */
-static void
-put_cell(const coord_t pos, cell_t element) {
-    put_board(pos, element);
-    uint32_t color = map_color(element);
-    gfx_draw_rect(pos.x * cellWidth, pos.y * cellWidth, cellWidth, cellWidth, color);
-}
-
-
-void
-put_board(const coord_t pos, cell_t element) {
-    //put element onto board
-    board[pos.x][pos.y] = element;
+int
+poll_during_search(uint64_t endTime) {
+    // AI threads must not touch the keyboard; the main thread is idle
+    // while they search anyway (see snapshot_computer_moves()). Neither
+    // must the threads of the other games (see multiboard.c).
+    if (!aiThreadsBusy && get_game() == 0) {
+        read_user_input(numHumanPlayers);
+    }
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+    // the AI domain has the main thread do it
+    if (get_game() == AI_DOMAIN_GAME) {
+        ai_domain_poll();
+    }
+#endif
+    return get_current_time() > endTime;
 }
 
 
-int
-isempty_cell(const coord_t pos) {
-    int cell = board[pos.x][pos.y];
-    return (cell != CELL_P0 && cell != CELL_P1 && cell != CELL_WALL);
+/*
+ * Map cell "element" to a color.
+ */
+static int32_t
+map_color(cell_t element) {
+    // the pixel format does not change; map the colors once
+    static uint32_t colors[CELL_LEN];
+    static int mapped = 0;
+    if (!mapped) {
+        colors[CELL_EMPTY] = 0;
+        colors[CELL_P0] = gfx_map_color(0, 200, 0);
+        colors[CELL_P1] = gfx_map_color(0, 0, 200);
+        colors[CELL_WALL] = gfx_map_color(200, 0, 0);
+        mapped = 1;
+    }
+    return colors[element];
 }
 
 
-cell_t
-get_cell(const coord_t pos) {
-    return board[pos.x][pos.y];
+/*
+ * Draw the empty board with its walls on screen. The first time, this
+ * draws one rectangle per wall and keeps a copy of the result; every
+ * later round just copies it back onto the screen.
+ */
+static void
+draw_empty_board() {
+    static uint32_t* background = NULL;
+    if (background == NULL) {
+        render_rect(0, 0, XRES, YRES, map_color(CELL_WALL));
+        render_rect(cellWidth, cellWidth, XRES - 2 * cellWidth,
+                YRES - 2 * cellWidth, map_color(CELL_EMPTY));
+        background = alloc_pages(XRES * YRES * sizeof(uint32_t));
+        // executed in order, so the copy is there before it is needed
+        render_save(0, 0, XRES, YRES, background);
+    } else {
+        render_restore(0, 0, XRES, YRES, background);
+    }
 }
 
 
@@ -343,27 +528,23 @@ get_cell(const coord_t pos) {
  */
 static void
 init_game_newround() {
+    memstat_sample();
     p0->direction = p1->direction = North;
     p0->pos.x = numCellsX * 3 / 4;
     p1->pos.x = numCellsX * 1 / 4;
     p0->pos.y = p1->pos.y = numCellsY / 2;
 
     // clear board and draw boarder walls
-    for (int y = 0; y < numCellsY; y++) {
-        for (int x = 0; x < numCellsX; x++) {
-            if (x == 0 || x == numCellsX -1  || y == 0 || y == numCellsY - 1) {
-                //coord_t p = {x,y};
-                put_cell((coord_t){x,y}, CELL_WALL);
-            } else {
-                put_cell((coord_t){x,y}, CELL_EMPTY);
-            }
-        }
-    }
+    board_reset();
+    draw_empty_board();
 
     // place players at start position
     for (int i = 0; i < NUMPLAYERS; i++) {
         put_board(players[i].pos, players[i].entity);
     }
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+    ai_domain_newround(players);
+#endif
 
     // initialize input queues
     init_nextdir();
@@ -390,44 +571,37 @@ init_game_all() {
 
 
 /*
- * Update player position according to current direction.
- * Draw a line (a filled rectangle) from old to new cell position.
- * @param p: player p0 or p1
- * @return: 0 move was okay (new cell was empty); 1 cell was not empty
+ * Draw the line (a filled rectangle) of the last move of player p, from
+ * its old to its new cell position, in color c.
  */
-static int
-update_world(player_t* p) {
-    /* delta step (cells) */
-    static const coord_t delta[] = {{-1, 0}, {0,-1}, {1,0}, {0,1}};
+static void
+draw_move(player_t* p, uint32_t c) {
     /* offset from top left corner of cell to top left corner of rect. (pixel) */
-    static const int offset = (cellWidth - lineWidth ) / 2;
+    const int offset = (cellWidth - lineWidth ) / 2;
     /* undo delta step if move was East or South because we start drawing
      * rectangle from the cell closer to the top left corner of the board */
     static const coord_t start[] = { {0,0}, {0,0}, {-1,0}, {0,-1}};
     /* width and height of rectangle we draw (pixels)*/
-    static const coord_t wh[] = {
+    const coord_t wh[] = {
             {cellWidth + lineWidth,lineWidth},
             {lineWidth,cellWidth + lineWidth},
             {cellWidth + lineWidth,lineWidth},
             {lineWidth,cellWidth + lineWidth}
     };
 
-    p->pos.x += delta[p->direction].x;
-    p->pos.y += delta[p->direction].y;
-
     /* rectangle, top left corner (pixels) */
     int lx = (p->pos.x + start[p->direction].x) * cellWidth + offset;
     int ly = (p->pos.y + start[p->direction].y) * cellWidth + offset;
 
-    gfx_draw_rect(lx, ly, wh[p->direction].x, wh[p->direction].y,
-            map_color(p->entity));
+    render_rect(lx, ly, wh[p->direction].x, wh[p->direction].y, c);
+}
 
-    if (isempty_cell(p->pos)) {
-        put_board(p->pos, p->entity);
-        return 0;
-    }
 
-    /* player p has crashed, so the other player has won */
+/*
+ * Player p has crashed, so the other player has won.
+ */
+static void
+announce_winner(player_t* p) {
     player_t* pwinning = p == p0 ? p1 : p0;
     pwinning->score++;
     printf("\n\nGAME OVER: %s wins!\n", pwinning->name);
@@ -436,52 +610,600 @@ update_world(player_t* p) {
             , p1->name, p1->score);
     char win_filename[30];
     sprintf(win_filename, "player%dwins.ppm", pwinning - players);
-    gfx_diplay_ppm((XRES - 120) / 2, YRES / 3, win_filename, 0.6);
+    render_ppm((XRES - 120) / 2, YRES / 3, win_filename, 0.6);
+}
 
-    return 1;
+
+/*
+ * Update player position according to current direction, and draw the move.
+ * @param p: player p0 or p1
+ * @return: 0 move was okay (new cell was empty); 1 cell was not empty
+ */
+static int
+update_world(player_t* p) {
+    int crashed = move_apply(p, p->direction);
+    draw_move(p, map_color(p->entity));
+    if (crashed) {
+        announce_winner(p);
+    }
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+    if (!crashed) {
+        ai_domain_moved(p);
+    }
+#endif
+    return crashed;
+}
+
+
+/*
+ * Let both computer players decide on their next move based on the same
+ * state of the board. With AI threads, each move is computed on a thread of
+ * its own (sharing the core); otherwise one after the other.
+ */
+static void
+snapshot_computer_moves(uint64_t endTime) {
+#ifdef CONFIG_APP_TRON_SMP_AI
+    aiThreadsBusy = 1;
+    share_computer_board(1);
+    ai_threads_move(endTime, players);
+    share_computer_board(0);
+    aiThreadsBusy = 0;
+#else
+    direction_t dir[NUMPLAYERS];
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        dir[i] = get_computer_move(endTime, players + i,
+                players + (i + 1) % NUMPLAYERS);
+    }
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        players[i].direction = dir[i];
+    }
+#endif
 }
 
 
 /*
- * Main game loop.
- * @param numPl: number of human players; 0, 1, or 2
+ * Let computer player pl decide on its next move, and tell how much work
+ * that was (see get_computer_move() and get_computer_work()). With the AI
+ * domain, the move is decided there.
+ */
+static direction_t
+computer_move(uint64_t endTime, int pl, unsigned long* work) {
+    player_t* me = players + pl;
+    player_t* you = players + (pl + 1) % NUMPLAYERS;
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+    direction_t dir = ai_domain_move(endTime, me, you);
+    *work += ai_domain_work(me);
+#else
+    direction_t dir = get_computer_move(endTime, me, you);
+    *work += get_computer_work(me);
+#endif
+    return dir;
+}
+
+
+/*
+ * Time player pl takes to move one cell from "step" on (parts of ticks).
+ */
+static int
+move_interval(int pl, int step, int parts) {
+    return step < turboEnd[pl] ? parts / TICK_PARTS : parts;
+}
+
+
+/*
+ * Start a turbo boost of human player pl in "step" if the player asked for
+ * one (and the last one is long enough ago), or if the replay says so.
+ */
+static void
+update_turbo(int pl, int step, int mode) {
+    int turbo;
+    if (mode == PLAY_GAME) {
+        turbo = pendingTurbo[pl] && step >= turboNext[pl];
+        pendingTurbo[pl] = 0;
+        if (turbo) {
+            replay_record_turbo(step, pl);
+        }
+    } else {
+        turbo = replay_play_turbo(step, pl);
+    }
+    if (turbo) {
+        turboEnd[pl] = step + TURBO_TICKS * TICK_PARTS;
+        turboNext[pl] = step + TURBO_COOLDOWN * TICK_PARTS;
+        dprintf("%s: turbo\n", players[pl].name);
+    }
+}
+
+
+/*
+ * Main game loop. Every game is recorded (see replay.c).
+ *
+ * Each player moves when it is due (see sched.c): every tick, or every
+ * part of a tick during a turbo boost. Steps count parts of ticks
+ * (REPLAY_HALF_TICKS; whole ticks in older replays). The timer is armed
+ * for the next step in which somebody moves; the others are skipped.
+ * @param numPl: number of human players; 0, 1, or 2 (ignored for replays)
  * @param startDir: start direction of player p0; may be different from
  *        default direction when game was started with direction key press.
+ * @param mode: PLAY_GAME, or play back the last recorded game at normal
+ *        speed (PLAY_REPLAY) or as fast as possible (PLAY_REPLAY_FAST)
  * @return: 0 game ended regularly; 1=cancel key was pressed
  */
 static int
-run_game(int numPl, direction_t startDir) {
+run_game(int numPl, direction_t startDir, int mode) {
     const uint64_t dt = (10 * NS_IN_MS) * 100 / speed;
     int game_over = 0;
     int cancel = 0;
     int step = 0;
+    int loser = -1;
+    int maxSteps = -1;
+    uint32_t seeds[NUMPLAYERS];
+    /* direction of players in previous tick (recording) or recorded
+     * direction (playback) */
+    direction_t lastDir[NUMPLAYERS];
+    /* first tick in which a computer player deviated from the replay */
+    int diverged = -1;
+    /* REPLAY_SNAPSHOT: computer players decide on the same board */
+    int flags = 0;
+    /* work the computer players did (see get_computer_work()) */
+    unsigned long work = 0;
+    int computerMoves = 0;
+    /* parts of a tick (steps) */
+    int parts = TICK_PARTS;
+
+    if (mode == PLAY_GAME) {
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            seeds[i] = get_current_time() * (i + 1);
+        }
+        flags |= get_computer_level() << REPLAY_LEVEL_SHIFT;
+        flags |= REPLAY_HALF_TICKS;
+#ifdef CONFIG_APP_TRON_SMP_AI
+        if (numPl == 0) {
+            flags |= REPLAY_SNAPSHOT;
+        }
+#endif
+    } else if (replay_play_start(&numPl, &flags, seeds) == 0) {
+        maxSteps = replay_play_steps();
+        if (!(flags & REPLAY_HALF_TICKS)) {
+            parts = 1;
+        }
+    } else {
+        return 0;
+    }
 
     assert(0 <= numPl && numPl <= 2);
+    // play back at the level the game was recorded at
+    int level = get_computer_level();
+    set_computer_level((flags >> REPLAY_LEVEL_SHIFT) % AI_LEVELS);
+    /* players whose recorded moves are played back; the others search */
+    int numFollowed = numPl;
+    if (mode != PLAY_GAME && numPl < NUMPLAYERS
+    && is_computer_level_timed(get_computer_level())) {
+        // searching again would give other moves on a machine of another
+        // speed (or under other load); show the game as it was played
+        printf("replay: level \"%s\" depends on the speed of the machine "
+                "and is not reproducible; playing back the recorded moves\n",
+                get_computer_level_name(get_computer_level()));
+        numFollowed = NUMPLAYERS;
+    }
+    numHumanPlayers = mode == PLAY_GAME ? numPl : 0;
+    pendingCancel = pendingPause = 0;
     init_game_newround();
     init_computer_move();
     p0->direction = startDir;
-    start_periodic_timer();
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        players[i].rng = seeds[i];
+        lastDir[i] = North;
+    }
+    if (mode == PLAY_GAME) {
+        replay_record_start(numPl, flags, seeds);
+    }
+    sched_reset();
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        sched_push(0, i);
+        pendingTurbo[i] = turboEnd[i] = turboNext[i] = 0;
+    }
+    const uint64_t part = dt / parts;
+    uint64_t lastTime = get_current_time();
+    int lastStep = 0;
 
-    while (!cancel && !game_over) {
+    while (!cancel && !game_over && (maxSteps < 0 || step < maxSteps)) {
+        if (mode != PLAY_REPLAY_FAST) {
+            wait_until(lastTime + (step - lastStep) * part);
+        }
         uint64_t startTime = get_current_time();  // in ns
-        cancel = handle_user_input(numPl);
+        lastTime = startTime;
+        lastStep = step;
+        // the players that move now
+        int due = 0;
+        int numDue = 0;
+        while (sched_next() == step) {
+            int pl;
+            sched_pop(&pl);
+            due |= 1 << pl;
+            numDue++;
+        }
+        cancel = handle_user_input(numHumanPlayers, due);
+        for (int pl = 0; pl < numPl && parts > 1 && !cancel; pl++) {
+            if (due & 1 << pl) {
+                update_turbo(pl, step, mode);
+            }
+        }
+        // time until the next move of any player
+        int span = sched_next() >= 0 ? sched_next() - step : parts;
+        for (int pl = 0; pl < NUMPLAYERS; pl++) {
+            if ((due & 1 << pl) && move_interval(pl, step, parts) < span) {
+                span = move_interval(pl, step, parts);
+            }
+        }
+        const uint64_t endTime = startTime + span * part;
+        if ((flags & REPLAY_SNAPSHOT) && numDue == NUMPLAYERS && !cancel
+        && numFollowed < NUMPLAYERS) {
+            snapshot_computer_moves(endTime);
+        }
+        int k = 0;
+        for (int pl = 0; pl < NUMPLAYERS && !cancel && !game_over; pl++) {
+            if (!(due & 1 << pl)) {
+                continue;
+            }
+            player_t* p = players + pl;
+            k++;
+            if (pl >= numFollowed) {
+                if (!(flags & REPLAY_SNAPSHOT)) {
+                    // computer player; the players that move now share
+                    // the time, the first gets the first share
+                    p->direction = computer_move(
+                            startTime + span * part * k / numDue, pl, &work);
+                } else {
+                    work += get_computer_work(p);
+                }
+                computerMoves++;
+            }
+            if (mode == PLAY_GAME) {
+                if (step == 0 || p->direction != lastDir[pl]) {
+                    replay_record_dir(step, pl, p->direction);
+                    lastDir[pl] = p->direction;
+                }
+            } else {
+                int dir = replay_play_dir(step, pl);
+                if (dir >= 0) {
+                    lastDir[pl] = dir;
+                }
+                if (pl < numFollowed) {
+                    p->direction = lastDir[pl];
+                } else if (p->direction != lastDir[pl] && diverged < 0) {
+                    diverged = step;
+                    printf("replay: %s deviates in tick %d\n", p->name,
+                            step / parts);
+                }
+            }
+            game_over = update_world(p);
+            if (game_over) {
+                loser = pl;
+            } else {
+                sched_push(step + move_interval(pl, step, parts), pl);
+            }
+        }
+        render_present();
         if (!cancel) {
-            if (numPl == 0) {
-                p0->direction = get_computer_move(startTime + dt / 2, p0, p1);
+            step = game_over ? step + 1 : sched_next();
+        }
+    }
+    printf("Game lasted %d moves.\n", (step + parts - 1) / parts);
+    if (computerMoves > 0) {
+        printf("computer player (%s): %lu work per move\n",
+                get_computer_level_name(get_computer_level()),
+                work / computerMoves);
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+        ai_domain_report();
+#endif
+    }
+    set_computer_level(level);
+#ifdef CONFIG_APP_TRON_RENDER_THREAD
+    int depth, maxDepth, stalls;
+    render_get_stats(&depth, &maxDepth, &stalls);
+    printf("render queue: %d commands, at most %d, full %d times\n",
+            depth, maxDepth, stalls);
+#endif
+    if (mode == PLAY_GAME) {
+        replay_record_end(step, cancel ? -1 : loser);
+    } else if (!cancel) {
+        replay_play_end(step, loser);
+    }
+    return cancel;
+}
+
+
+/*
+ * Multi-board mode: let the computer players play the games of
+ * multiboard.c, and show them, until ESC is pressed.
+ * @return: 1 (back to the start screen)
+ */
+static int
+run_multiboard() {
+    // the game threads draw themselves
+    render_sync();
+    if (multiboard_start() != 0) {
+        return 1;
+    }
+    uint64_t frame = get_current_time();
+    while (ps_cdev_getchar(&inputdev) != 27) {
+        frame += MULTIBOARD_FRAME;
+        wait_until(frame);
+        multiboard_present();
+    }
+    multiboard_stop();
+    return 1;
+}
+
+
+/* network games: how many ticks a game may run ahead of the other
+ * side's input (see run_netgame()) */
+#define NET_AHEAD 8
+
+/* the inputs of both players are kept from NET_AHEAD ticks back (for
+ * rollbacks) to as far as the other side can be ahead of us */
+#define NET_INPUTS (4 * NET_AHEAD)
+
+/* network games: the sides compare the hashes of their boards every
+ * NET_CHECK ticks; more than NET_AHEAD, so that at most one checkpoint is
+ * waiting for the other side's input */
+#define NET_CHECK 64
+
+
+/*
+ * Take back the last move of player p. If the move is on screen, draw
+ * over it with the background color.
+ */
+static void
+undo_move(player_t* p, int drawn) {
+    if (drawn) {
+        draw_move(p, map_color(CELL_EMPTY));
+    }
+    move_undo();
+}
+
+
+/*
+ * Play one tick of a network game: move the players in directions dir[].
+ * @param confirmed: 1 if dir[] are the players' actual inputs; 0 if
+ *        some are predicted; a crash in a predicted tick is taken back
+ *        (it may not happen), and so is the rest of the tick
+ * @return: the player that crashed; -1 if none did
+ */
+static int
+net_tick(const direction_t* dir, int confirmed) {
+    for (int pl = 0; pl < NUMPLAYERS; pl++) {
+        player_t* p = players + pl;
+        if (move_apply(p, dir[pl]) == 0) {
+            draw_move(p, map_color(p->entity));
+            continue;
+        }
+        if (confirmed) {
+            draw_move(p, map_color(p->entity));
+            announce_winner(p);
+        } else {
+            undo_move(p, 0);
+            while (--pl >= 0) {
+                undo_move(players + pl, 1);
             }
-            game_over = update_world(p0);
-            if (!game_over) {
-                if (numPl == 0 || numPl == 1) {
-                    p1->direction = get_computer_move(startTime + dt, p1, p0);
+        }
+        return p - players;
+    }
+    return -1;
+}
+
+
+/*
+ * Play a game against another instance of seL4Tron over COM2 (see
+ * netplay.c); each side plays one player.
+ *
+ * Waiting for the other side's input in every tick would make the game
+ * as slow as the link. Instead, we assume that the other player keeps
+ * going in the same direction, and play on (up to NET_AHEAD ticks). When
+ * the other side's input arrives and differs from our guess, we roll the
+ * board back (with the undo stack; see board.c) to the first tick we got
+ * wrong, and play the ticks since then again. The game is over once a
+ * player crashes in a tick for which we have both inputs.
+ *
+ * Both sides send the hash of their board every NET_CHECK ticks, once
+ * they have the inputs up to then. If the hashes differ, the games have
+ * gone apart (e.g. the sides run different versions) and the game is
+ * cancelled; so is it when the other side violates the protocol.
+ * @return: 0 game ended regularly; 1=cancel key was pressed, the other
+ *          side quit or sent something wrong, or there was no other side
+ */
+static int
+run_netgame() {
+    netplay_init(&io_ops);
+    printf("netplay: waiting for the other side on COM2\n");
+    int local = netplay_connect(30000ULL * NS_IN_MS);
+    if (local < 0) {
+        return 1;
+    }
+    const int remote = 1 - local;
+    printf("netplay: you are %s\n", players[local].name);
+
+    /* inputs of both players; tick t at input[t % NET_INPUTS] */
+    direction_t input[NET_INPUTS][NUMPLAYERS];
+    /* ticks played (on screen) */
+    int tick = 0;
+    /* ticks we know the other side's input of */
+    int known = 0;
+    /* ticks we have sent our input of */
+    int sent = 0;
+    /* last input of the other side; our guess for the ticks after */
+    direction_t lastRemote = North;
+    /* checkpoint (tick) of the last board hash taken, sent, received, and
+     * compared; the hashes */
+    int hashTick = 0;
+    int sentTick = 0;
+    int recvTick = 0;
+    int checkTick = 0;
+    uint64_t hash = 0;
+    uint64_t sentHash = 0;
+    uint64_t recvHash = 0;
+    int cancel = 0;
+    int loser = -1;
+    /* statistics */
+    int rollbacks = 0;
+    int replayed = 0;
+    int stalls = 0;
+    uint64_t replayTime = 0;
+
+    pendingCancel = pendingPause = 0;
+    init_game_newround();
+    start_periodic_timer();
+
+    while (!cancel && loser < 0) {
+        // our input for the next tick (once)
+        read_user_input(1);
+        pendingPause = 0; // the other side would not wait
+        if (pendingCancel) {
+            netplay_send_quit();
+            cancel = 1;
+            break;
+        }
+        if (sent == tick) {
+            direction_t d = players[local].direction;
+            int newdir;
+            while ((newdir = get_nextdir(0)) >= 0) {
+                // skip over forward and backward moves
+                if (newdir != d && newdir != dir_back[d]) {
+                    d = newdir;
+                    break;
+                }
+            }
+            input[tick % NET_INPUTS][local] = d;
+            netplay_send(d);
+            sent++;
+        }
+
+        // the other side's input; note the first tick we got wrong
+        int wrong = -1;
+        int r;
+        uint64_t h;
+        while ((r = netplay_recv(&h)) != NETPLAY_NONE) {
+            if (r == NETPLAY_QUIT) {
+                printf("netplay: the other side quit\n");
+                cancel = 1;
+                break;
+            }
+            if (r == NETPLAY_HASH) {
+                recvTick += NET_CHECK;
+                recvHash = h;
+                if (recvTick > known) {
+                    printf("netplay: protocol error (hash of tick %d before "
+                            "its inputs)\n", recvTick);
+                    cancel = 1;
+                    break;
+                }
+                continue;
+            }
+            // the other side cannot be further ahead than NET_AHEAD ticks
+            // of our input; if it is, it does not play by the rules
+            if (known - tick >= NET_INPUTS - NET_AHEAD) {
+                printf("netplay: protocol error (input for tick %d; we are "
+                        "at tick %d)\n", known, tick);
+                cancel = 1;
+                break;
+            }
+            direction_t* in = &input[known % NET_INPUTS][remote];
+            if (known < tick && *in != (direction_t)r && wrong < 0) {
+                wrong = known;
+            }
+            *in = r;
+            lastRemote = r;
+            known++;
+        }
+        if (cancel) {
+            netplay_send_quit();
+            break;
+        }
+
+        // roll back to the first wrong tick and play again from there,
+        // then play the next tick
+        int played = tick;
+        uint64_t start = get_current_time();
+        if (wrong >= 0) {
+            rollbacks++;
+            replayed += tick - wrong;
+            for (; tick > wrong; tick--) {
+                for (int pl = NUMPLAYERS - 1; pl >= 0; pl--) {
+                    undo_move(players + pl, 1);
+                }
+            }
+            if (tick > 0) {
+                // undo_move() also drew over the end of these lines
+                for (int pl = 0; pl < NUMPLAYERS; pl++) {
+                    draw_move(players + pl, map_color(players[pl].entity));
+                }
+            }
+        }
+        int target = played;
+        if (played < sent && played - known < NET_AHEAD) {
+            target++;
+        }
+        uint64_t end = 0;
+        while (tick < target) {
+            direction_t* in = input[tick % NET_INPUTS];
+            if (tick >= known) {
+                in[remote] = lastRemote;
+            }
+            int crashed = net_tick(in, tick < known);
+            if (crashed >= 0) {
+                if (tick < known) {
+                    loser = crashed;
+                    tick++;
                 }
-                game_over = update_world(p1);
+                // else: wait for the other side's input
+                break;
+            }
+            tick++;
+            if (tick % NET_CHECK == 0) {
+                hash = board_hash();
+                hashTick = tick;
+            }
+            if (tick == played) {
+                end = get_current_time();
+            }
+        }
+        if (wrong >= 0) {
+            replayTime += (end ? end : get_current_time()) - start;
+        }
+        if (tick <= played) {
+            stalls++;
+        }
+
+        // the hash of the last checkpoint is final once we have played it
+        // with both inputs; compare it with the other side's
+        if (hashTick > sentTick && hashTick <= known && hashTick <= tick) {
+            netplay_send_hash(hash);
+            sentTick = hashTick;
+            sentHash = hash;
+        }
+        if (recvTick > checkTick && recvTick == sentTick) {
+            checkTick = recvTick;
+            if (recvHash != sentHash) {
+                printf("netplay: the boards differ after tick %d (%016llx vs "
+                        "%016llx); game cancelled\n", checkTick,
+                        (unsigned long long)sentHash,
+                        (unsigned long long)recvHash);
+                netplay_send_quit();
+                cancel = 1;
+                break;
             }
         }
+
+        render_present();
         wait_for_timer();
-        step++;
     }
     stop_periodic_timer();
-    printf("Game lasted %d moves.\n", step);
+    printf("Game lasted %d moves.\n", tick);
+    printf("netplay: %d rollbacks, %d ticks played again (%llu us), "
+            "%d ticks waited for the other side, %d board hashes "
+            "compared\n", rollbacks, replayed,
+            (unsigned long long)(replayTime / 1000), stalls,
+            checkTick / NET_CHECK);
     return cancel;
 }
 
@@ -494,9 +1216,10 @@ static void
 show_startscreen() {
     /* width of actual screen (pixels) */
     int width = bootinfo2->vbeModeInfoBlock.xRes;
-    gfx_fill_screen(0);
-    gfx_diplay_ppm((width - 200) / 2, 30, "title.ppm", 1);
-    gfx_diplay_ppm((width - 160) / 2, 150, "menu.ppm", 1);
+    render_fill(0);
+    render_ppm((width - 200) / 2, 30, "title.ppm", 1);
+    render_ppm((width - 160) / 2, 150, "menu.ppm", 1);
+    render_present();
 }
 
 
@@ -504,8 +1227,8 @@ static void
 *main_continued()
 {
     if (bootinfo2 == NULL
-    || bootinfo2->vbeModeInfoBlock.xRes < XRES
-    || bootinfo2->vbeModeInfoBlock.yRes < YRES
+    || bootinfo2->vbeModeInfoBlock.xRes < MIN_XRES
+    || bootinfo2->vbeModeInfoBlock.yRes < MIN_YRES
     || bootinfo2->vbeModeInfoBlock.bitsPerPixel != 32) {
         printf("Error: minimum graphics requirements not met\n");
         printf("Please boot the kernel in graphics mode ");
@@ -516,21 +1239,105 @@ static void
 
     printf("initialize keyboard\n");
     init_cdev(PC99_KEYBOARD_PS2, &inputdev);
+    bootprof_mark("keyboard init");
 
+#ifndef CONFIG_APP_TRON_FAST_BOOT
     gfx_print_IA32BootInfo(bootinfo2);
+    bootprof_mark("VBE info");
+#endif
     gfx_init_IA32BootInfo(bootinfo2);
+#ifdef CONFIG_APP_TRON_PAGE_FLIP
+    gfx_init_page_flip(&io_ops.io_port_ops);
+#endif
     gfx_map_video_ram(&io_ops.io_mapper);
+    bootprof_mark("video mapping");
+#ifdef CONFIG_APP_TRON_FAST_BOOT
+    gfx_tune_video_ram(&vspace, 0);
+#else
+    gfx_tune_video_ram(&vspace, 1);
+    bootprof_mark("video self-test");
     gfx_display_testpic();
+    gfx_present();
+    bootprof_mark("test picture");
     gfx_diplay_ppm(0, 0, "sel4.ppm", 1);
+    gfx_present();
+    bootprof_mark("splash screen");
+#endif
+    init_board();
+    bootprof_mark("board init");
+#ifdef CONFIG_APP_TRON_GFX_BENCH
+    gfx_bench(bootinfo2->vbeModeInfoBlock.xRes,
+            bootinfo2->vbeModeInfoBlock.yRes);
+    bootprof_mark("graphics benchmark");
+#endif
+
+    replay_init();
+    unsigned long size;
+    void* rp = cpio_get_file(_cpio_archive, "replay.trr", &size);
+    if (rp != NULL && replay_load(rp, size) == 0) {
+        printf("loaded replay.trr (press 'r' or 'R' to play it back)\n");
+    }
+
+    void* weights = cpio_get_file(_cpio_archive, "evalweights.txt", &size);
+    if (weights != NULL && eval_load(weights, size) == 0) {
+        printf("loaded evaluation function\n");
+    }
+
+    void* rules = cpio_get_file(_cpio_archive, "rules.txt", &size);
+    if (rules != NULL && rules_load(rules, size) == 0) {
+        printf("loaded rules.txt\n");
+    }
+
+    void* book = cpio_get_file(_cpio_archive, "book.bin", &size);
+    if (book != NULL && book_load(book, size) == 0) {
+        printf("loaded opening book\n");
+    }
+    bootprof_mark("replay, weights, and book");
 
     printf("initialize timers\n");
     fflush(stdout);
     init_timers();
     printf("done\n");
-
+    bootprof_mark("init_timers");
+
+#ifdef CONFIG_APP_TRON_SMP_AI
+    ai_threads_init(&vka, &vspace, &simple);
+    bootprof_mark("AI threads");
+#endif
+#ifdef CONFIG_APP_TRON_MULTIBOARD
+    multiboard_init(&vka, &vspace, &simple);
+    bootprof_mark("game threads");
+#endif
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+    ai_domain_init(&vka, &vspace, &simple);
+    bootprof_mark("AI domain");
+#endif
+#ifdef CONFIG_APP_TRON_RENDER_THREAD
+    // the render thread must not allocate memory; decode images now
+    gfx_load_ppm("title.ppm");
+    gfx_load_ppm("menu.ppm");
+    gfx_load_ppm("player0wins.ppm");
+    gfx_load_ppm("player1wins.ppm");
+    render_init(&vka, &vspace, &simple);
+    bootprof_mark("render thread");
+#endif
+
+    int booted = 0;
     for (;;) {
         init_game_all();
         show_startscreen();
+        if (!booted) {
+            render_sync();
+            bootprof_mark("start screen");
+            bootprof_report();
+            printf("computer player: %s (press 'l' to change)\n",
+                    get_computer_level_name(get_computer_level()));
+#ifdef CONFIG_APP_TRON_FAST_BOOT
+            // deferred until the game is up
+            gfx_print_IA32BootInfo(bootinfo2);
+#endif
+            booted = 1;
+        }
         int cancel = 0;
         int startscreen = 1; // we are on start screen
         while (!cancel) { // (1)
@@ -540,7 +1347,9 @@ static void
                 // ESC was pressed
                 if (startscreen) {
                     // ESC on start screen means quit game
-                    gfx_fill_screen(0);
+                    render_fill(0);
+                    render_present();
+                    render_sync();
                     return NULL;
                 } else {
                     // ESC on game-over screen means show start screen
@@ -551,14 +1360,51 @@ static void
             case '1': /* fall through */
             case '2':
                 startscreen = 0;
-                cancel = run_game(c - '0', North);
+                cancel = run_game(c - '0', North, PLAY_GAME);
+                break;
+            case 'r':
+                // play back the last game at normal speed
+                startscreen = 0;
+                cancel = run_game(0, North, PLAY_REPLAY);
+                break;
+            case 'R':
+                // play back the last game without waiting for the timer
+                startscreen = 0;
+                cancel = run_game(0, North, PLAY_REPLAY_FAST);
+                break;
+            case 'n':
+                // play against another machine over COM2
+                startscreen = 0;
+                cancel = run_netgame();
+                break;
+            case 'd':
+                replay_dump();
+                break;
+#ifdef CONFIG_APP_TRON_MULTIBOARD
+            case 'b':
+                // computer against computer on several boards at once
+                if (startscreen) {
+                    cancel = run_multiboard();
+                }
+                break;
+#endif
+            case 'u':
+                memstat_report();
+                break;
+            case 'l':
+                if (startscreen) {
+                    int level = (get_computer_level() + 1) % AI_LEVELS;
+                    set_computer_level(level);
+                    printf("computer player: %s\n",
+                            get_computer_level_name(level));
+                }
                 break;
             default:
                 // game starts with "direction key" press
                 for (int i = 0; i < DirLength; i++) {
                     if (keymap[0][i] == c) {
                         startscreen = 0;
-                        cancel = run_game(1, dir_forward[i]);
+                        cancel = run_game(1, dir_forward[i], PLAY_GAME);
                     }
                 }
                 break;
@@ -571,16 +1417,22 @@ static void
 
 int main()
 {
+    bootprof_mark("kernel handoff");
     setup_system();
+    bootprof_mark("setup_system");
 
     /* enable serial driver */
     platsupport_serial_setup_simple(NULL, &simple, &vka);
+    bootprof_mark("serial setup");
 
     printf("\n\n========= seL4Tron ========= \n\n");
 
-    // stack size is configurable via CONFIG_SEL4UTILS_STACK_SIZE
-    int err = (int)sel4utils_run_on_stack(&vspace, main_continued, NULL);
-    assert(err == 0);
+    // stack size is configurable via CONFIG_SEL4UTILS_STACK_SIZE; it is
+    // painted before we switch to it (see memstat.c)
+    void* stackTop = vspace_new_stack(&vspace);
+    assert(stackTop != NULL);
+    memstat_add_stack("main stack", stackTop);
+    utils_run_on_stack(stackTop, main_continued, NULL);
     printf("Bye!\n\n");
     return 0;
 }
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Memory telemetry: how close the root task gets to the limits of its
+ * stacks and memory pools.
+ *
+ * Stacks (and the allocator's static memory pool) are "painted": filled
+ * with a pattern before they are used. The high-water mark is where the
+ * pattern has been overwritten; i.e. the most that was ever used.
+ *
+ * The VKA handed to everything else is wrapped, so that every cslot and
+ * kernel object allocated (frames, TCBs, endpoints, ...) is counted,
+ * along with the untyped memory behind them.
+ *
+ * memstat_sample() is called at the start of every round and says when
+ * a high-water mark has grown since the last round; memstat_report()
+ * prints the whole table.
+ */
+
+#include <autoconf.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <sel4/sel4.h>
+#include <vka/vka.h>
+#include <utils/util.h>
+#include "tron.h"
+#include "memstat.h"
+
+/* size of a stack from vspace_new_stack(), which all of our stacks come
+ * from (see main() and sel4utils_configure_thread()) */
+#define STACK_SIZE ROUND_UP(CONFIG_SEL4UTILS_STACK_SIZE, seL4_PageBits)
+
+/* what painted memory is filled with */
+#define PAINT 0x5ca1ab1eu
+
+/* maximum number of painted regions (the threads of the multi-board mode
+ * have a stack each) */
+#define MAX_REGIONS (8 + MAX_GAMES)
+
+typedef struct {
+    const char* name;
+    uint32_t* base;
+    /* number of words */
+    size_t size;
+    /* stacks grow down from the top */
+    int stack;
+    /* high-water mark at the last sample, in bytes */
+    size_t used;
+} region_t;
+
+static region_t regions[MAX_REGIONS];
+static int numRegions = 0;
+
+typedef struct {
+    long cur;
+    long peak;
+} counter_t;
+
+/* the allocations made through the VKA */
+static counter_t slots;
+static counter_t objects;
+static counter_t frames;
+static counter_t untypedBytes;
+static long failures = 0;
+
+/* the VKA that is wrapped */
+static vka_t inner;
+
+
+static void
+count(counter_t* c, long n) {
+    c->cur += n;
+    if (c->cur > c->peak) {
+        c->peak = c->cur;
+    }
+}
+
+
+static void
+add_region(const char* name, uint32_t* base, size_t size, int stack) {
+    assert(numRegions < MAX_REGIONS);
+    regions[numRegions++] = (region_t) {
+        .name = name,
+        .base = base,
+        .size = size,
+        .stack = stack,
+    };
+}
+
+
+/*
+ * Bytes of region r that have been used.
+ */
+static size_t
+high_water(const region_t* r) {
+    size_t untouched = 0;
+    if (r->stack) {
+        while (untouched < r->size && r->base[untouched] == PAINT) {
+            untouched++;
+        }
+    } else {
+        for (size_t i = 0; i < r->size; i++) {
+            untouched += r->base[i] == PAINT;
+        }
+    }
+    return (r->size - untouched) * sizeof(uint32_t);
+}
+
+
+/*
+ * Paint the memory at base (e.g. the allocator's static pool) before it
+ * is used. Its high-water mark is the number of bytes overwritten since,
+ * wherever they are.
+ */
+void
+memstat_paint(const char* name, void* base, size_t size) {
+    uint32_t* p = base;
+    for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+        p[i] = PAINT;
+    }
+    add_region(name, p, size / sizeof(uint32_t), 0);
+}
+
+
+/*
+ * Paint a stack that nothing runs on yet.
+ * @param top: the top of the stack, as returned by vspace_new_stack()
+ *             (see main(), and sel4utils_thread_t for threads)
+ */
+void
+memstat_add_stack(const char* name, void* top) {
+    uint32_t* base = (uint32_t*)((uintptr_t)top - STACK_SIZE);
+    for (size_t i = 0; i < STACK_SIZE / sizeof(uint32_t); i++) {
+        base[i] = PAINT;
+    }
+    add_region(name, base, STACK_SIZE / sizeof(uint32_t), 1);
+}
+
+
+static int
+count_cspace_alloc(void* data, seL4_CPtr* res) {
+    int err = inner.cspace_alloc(inner.data, res);
+    if (err == 0) {
+        count(&slots, 1);
+    } else {
+        failures++;
+    }
+    return err;
+}
+
+
+static void
+count_cspace_make_path(void* data, seL4_CPtr slot, cspacepath_t* res) {
+    inner.cspace_make_path(inner.data, slot, res);
+}
+
+
+static void
+count_cspace_free(void* data, seL4_CPtr slot) {
+    inner.cspace_free(inner.data, slot);
+    count(&slots, -1);
+}
+
+
+static int
+count_utspace_alloc(void* data, const cspacepath_t* dest, seL4_Word type,
+        seL4_Word sizeBits, uint32_t* res) {
+    int err = inner.utspace_alloc(inner.data, dest, type, sizeBits, res);
+    if (err == 0) {
+        count(&objects, 1);
+        count(&untypedBytes, BIT(sizeBits));
+        if (type == seL4_IA32_4K) {
+            count(&frames, 1);
+        }
+    } else {
+        failures++;
+    }
+    return err;
+}
+
+
+static void
+count_utspace_free(void* data, seL4_Word type, seL4_Word sizeBits,
+        uint32_t target) {
+    inner.utspace_free(inner.data, type, sizeBits, target);
+    count(&objects, -1);
+    count(&untypedBytes, -(long)BIT(sizeBits));
+    if (type == seL4_IA32_4K) {
+        count(&frames, -1);
+    }
+}
+
+
+static uintptr_t
+count_utspace_paddr(void* data, uint32_t target, seL4_Word type,
+        seL4_Word sizeBits) {
+    return inner.utspace_paddr(inner.data, target, type, sizeBits);
+}
+
+
+/*
+ * Count everything allocated through vka from now on; call before vka
+ * is handed to anything else. Like vka itself, not thread safe.
+ */
+void
+memstat_wrap_vka(vka_t* vka) {
+    inner = *vka;
+    vka->data = NULL;
+    vka->cspace_alloc = count_cspace_alloc;
+    vka->cspace_make_path = count_cspace_make_path;
+    vka->cspace_free = count_cspace_free;
+    vka->utspace_alloc = count_utspace_alloc;
+    vka->utspace_free = count_utspace_free;
+    vka->utspace_paddr = count_utspace_paddr;
+}
+
+
+/*
+ * Update the high-water marks, and say which ones have grown since the
+ * last sample.
+ */
+void
+memstat_sample() {
+    for (int i = 0; i < numRegions; i++) {
+        region_t* r = &regions[i];
+        size_t used = high_water(r);
+        if (used > r->used) {
+            dprintf("memstat: %s high-water mark %u -> %u bytes\n", r->name,
+                    (unsigned)r->used, (unsigned)used);
+            r->used = used;
+        }
+    }
+}
+
+
+void
+memstat_report() {
+    memstat_sample();
+    printf("=== memory ===\n");
+    printf("%-20s %10s %10s %5s\n", "region", "used", "size", "%");
+    for (int i = 0; i < numRegions; i++) {
+        region_t* r = &regions[i];
+        size_t size = r->size * sizeof(uint32_t);
+        printf("%-20s %10u %10u %4u%%%s\n", r->name, (unsigned)r->used,
+                (unsigned)size, (unsigned)(r->used * 100 / size),
+                r->used == size ? " (full; overflowed?)" : "");
+    }
+    printf("%-20s %10s %10s\n", "vka", "now", "peak");
+    printf("%-20s %10ld %10ld\n", "cslots", slots.cur, slots.peak);
+    printf("%-20s %10ld %10ld\n", "objects", objects.cur, objects.peak);
+    printf("%-20s %10ld %10ld\n", "  of which frames", frames.cur,
+            frames.peak);
+    printf("%-20s %10ld %10ld\n", "untyped bytes", untypedBytes.cur,
+            untypedBytes.peak);
+    printf("%-20s %10ld\n", "failed allocations", failures);
+    printf("=== memory end ===\n");
+}
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef MEMSTAT_H_
+#define MEMSTAT_H_
+
+#include <stddef.h>
+#include <vka/vka.h>
+
+void memstat_paint(const char* name, void* base, size_t size);
+void memstat_add_stack(const char* name, void* top);
+void memstat_wrap_vka(vka_t* vka);
+void memstat_sample();
+void memstat_report();
+
+
+#endif /* MEMSTAT_H_ */
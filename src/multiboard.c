@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Multi-board mode: MULTIBOARD_GAMES games of two computer players each, all
+ * at the same time. Every game has a thread and a tile of the screen; the
+ * thread plays one game after the other, as fast as the computer players
+ * decide, and draws each move into its tile.
+ *
+ * The kernel this app is built against runs on a single core and has no
+ * way to pin a thread to a core: the game threads time-share the core, so
+ * the games per second are those of one thread playing them in turn, and
+ * the more games, the slower each of them.
+ *
+ * The board (board.c) and the computer players (gameai.c, oppmodel.c)
+ * keep the state of every game apart; a game thread selects its game by
+ * setting the user data word of its IPC buffer (see get_game()). The
+ * size of the board in cells is the same for all games, so a tile scales
+ * the cells down instead.
+ *
+ * Drawing is not thread safe (see graphics.c): the game threads and
+ * multiboard_present() take turns through a spin lock, which the latter
+ * holds only while it copies the frame, not while it waits for the
+ * vertical retrace. The time each game
+ * waits for the lock is a measure of how much the games get in each
+ * other's way; so is the jitter of the time between ticks.
+ */
+
+#include <autoconf.h>
+#include <stdio.h>
+#include <assert.h>
+#include <sel4/sel4.h>
+#include <sel4utils/thread.h>
+#include <vka/object.h>
+#include "multiboard.h"
+#include "board.h"
+#include "graphics.h"
+#include "oppmodel.h"
+#include "memstat.h"
+
+/* time each computer player has per move; the work-budget levels
+ * usually decide sooner (see gameai.c) */
+#define MOVE_TIME (5 * NS_IN_MS)
+
+/* interval between reports of the number of games per second */
+#define REPORT_TIME (5000 * NS_IN_MS)
+
+typedef struct {
+    sel4utils_thread_t thread;
+    /* the main thread signals the start of the games */
+    vka_object_t request;
+    /* the game thread signals that it has stopped */
+    vka_object_t done;
+    /* top left corner of the game's board on screen (pixels) */
+    int x0;
+    int y0;
+    /* statistics since multiboard_start(); tick times and the time spent
+     * waiting for the screen lock are in cycles */
+    unsigned long games;
+    unsigned long ticks;
+    uint64_t tickSum;
+    double tickSquares;
+    uint64_t tickMax;
+    uint64_t lockWait;
+    char name[16];
+} game_t;
+
+/* game 0 is the one of the start screen; it has no thread */
+static game_t games[1 + MULTIBOARD_GAMES];
+
+/* set to make the game threads stop after their current tick */
+static volatile int stop = 0;
+
+/* spin lock that serializes drawing */
+static char screenLock = 0;
+
+/* width (and height) of a cell in a tile (pixels) */
+static int tileCell;
+
+static uint32_t colors[CELL_LEN];
+
+/* time of multiboard_start() and of the last report */
+static uint64_t startTime;
+static uint64_t reportTime;
+
+
+/*
+ * Take the screen lock.
+ * @return: cycles spent waiting for it
+ */
+static uint64_t
+lock_screen() {
+    if (!__atomic_test_and_set(&screenLock, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    uint64_t t0 = read_tsc();
+    while (__atomic_test_and_set(&screenLock, __ATOMIC_ACQUIRE)) {
+        // the holder needs the core to get done
+        seL4_Yield();
+    }
+    return read_tsc() - t0;
+}
+
+
+static void
+unlock_screen() {
+    __atomic_clear(&screenLock, __ATOMIC_RELEASE);
+}
+
+
+/*
+ * Draw cell pos of game gm in color c.
+ */
+static void
+draw_cell(game_t* gm, coord_t pos, uint32_t c) {
+    gm->lockWait += lock_screen();
+    gfx_draw_rect(gm->x0 + pos.x * tileCell, gm->y0 + pos.y * tileCell,
+            tileCell, tileCell, c);
+    unlock_screen();
+}
+
+
+/*
+ * Play one game on the board of the calling thread, and draw it into the
+ * tile of gm. Both computer players decide on the same board, as in
+ * snapshot_computer_moves() in main.c.
+ */
+static void
+play_game(game_t* gm) {
+    player_t pl[NUMPLAYERS] = {
+            {.entity = CELL_P0, .name = "GREEN", .direction = North,
+             .pos = {numCellsX * 3 / 4, numCellsY / 2}},
+            {.entity = CELL_P1, .name = "BLUE", .direction = North,
+             .pos = {numCellsX * 1 / 4, numCellsY / 2}}};
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        pl[i].rng = (uint32_t)read_tsc() * (i + 1);
+    }
+    board_reset();
+    opp_model_newgame();
+
+    gm->lockWait += lock_screen();
+    gfx_draw_rect(gm->x0, gm->y0, numCellsX * tileCell, numCellsY * tileCell,
+            colors[CELL_WALL]);
+    gfx_draw_rect(gm->x0 + tileCell, gm->y0 + tileCell,
+            (numCellsX - 2) * tileCell, (numCellsY - 2) * tileCell,
+            colors[CELL_EMPTY]);
+    unlock_screen();
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        put_board(pl[i].pos, pl[i].entity);
+        draw_cell(gm, pl[i].pos, colors[pl[i].entity]);
+    }
+
+    uint64_t last = read_tsc();
+    int crashed = 0;
+    while (!crashed && !stop) {
+        direction_t dir[NUMPLAYERS];
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            dir[i] = get_computer_move(get_current_time() + MOVE_TIME,
+                    pl + i, pl + (i + 1) % NUMPLAYERS);
+        }
+        for (int i = 0; i < NUMPLAYERS && !crashed; i++) {
+            crashed = move_apply(&pl[i], dir[i]);
+            draw_cell(gm, pl[i].pos, colors[pl[i].entity]);
+        }
+        uint64_t now = read_tsc();
+        uint64_t tick = now - last;
+        last = now;
+        gm->ticks++;
+        gm->tickSum += tick;
+        gm->tickSquares += (double)tick * tick;
+        if (tick > gm->tickMax) {
+            gm->tickMax = tick;
+        }
+    }
+    if (crashed) {
+        gm->games++;
+    }
+}
+
+
+/*
+ * Entry point of a game thread: play games from multiboard_start() to
+ * multiboard_stop(), every time.
+ */
+static void
+game_thread_run(void* arg0, UNUSED void* arg1, UNUSED void* ipc_buf) {
+    game_t* gm = arg0;
+    seL4_SetUserData(gm - games);
+    for (;;) {
+        seL4_Wait(gm->request.cptr, NULL);
+        while (!stop) {
+            play_game(gm);
+        }
+        seL4_Notify(gm->done.cptr, 1);
+    }
+}
+
+
+void
+multiboard_init(vka_t* vka, vspace_t* vspace, simple_t* simple) {
+    for (int g = 1; g <= MULTIBOARD_GAMES; g++) {
+        game_t* gm = &games[g];
+        // the allocators are not thread safe; the board and the computer
+        // players of game g get their memory here, on the main thread
+        seL4_SetUserData(g);
+        board_init(numCellsX, numCellsY);
+        init_computer_move();
+        seL4_SetUserData(0);
+
+        UNUSED int err = vka_alloc_async_endpoint(vka, &gm->request);
+        assert(err == 0);
+        err = vka_alloc_async_endpoint(vka, &gm->done);
+        assert(err == 0);
+        err = sel4utils_configure_thread(vka, vspace, vspace, seL4_CapNull,
+                seL4_MaxPrio, simple_get_cnode(simple), seL4_NilData,
+                &gm->thread);
+        assert(err == 0);
+        snprintf(gm->name, sizeof(gm->name), "game thread %d", g);
+        memstat_add_stack(gm->name, gm->thread.stack_top);
+        err = sel4utils_start_thread(&gm->thread, game_thread_run, gm, NULL,
+                1);
+        assert(err == 0);
+    }
+    printf("started %d game threads\n", MULTIBOARD_GAMES);
+}
+
+
+int
+multiboard_start() {
+    // as close to square as possible: cols x rows tiles
+    const int n = MULTIBOARD_GAMES;
+    int cols = 1;
+    while (cols * cols < n) {
+        cols++;
+    }
+    const int rows = (n + cols - 1) / cols;
+    const int tileW = XRES / cols;
+    const int tileH = YRES / rows;
+    tileCell = tileW / numCellsX;
+    if (tileH / numCellsY < tileCell) {
+        tileCell = tileH / numCellsY;
+    }
+    if (tileCell == 0) {
+        printf("multi-board: %d boards of %dx%d cells do not fit on screen\n",
+                n, numCellsX, numCellsY);
+        return -1;
+    }
+
+    colors[CELL_EMPTY] = 0;
+    colors[CELL_P0] = gfx_map_color(0, 200, 0);
+    colors[CELL_P1] = gfx_map_color(0, 0, 200);
+    colors[CELL_WALL] = gfx_map_color(200, 0, 0);
+    gfx_fill_screen(0);
+
+    stop = 0;
+    for (int g = 1; g <= MULTIBOARD_GAMES; g++) {
+        game_t* gm = &games[g];
+        // center the board in its tile
+        gm->x0 = (g - 1) % cols * tileW + (tileW - numCellsX * tileCell) / 2;
+        gm->y0 = (g - 1) / cols * tileH + (tileH - numCellsY * tileCell) / 2;
+        gm->games = gm->ticks = 0;
+        gm->tickSum = gm->tickMax = gm->lockWait = 0;
+        gm->tickSquares = 0;
+    }
+    printf("multi-board: %d games on %dx%d tiles, %d pixel cells "
+            "(ESC to stop)\n", n, cols, rows, tileCell);
+    startTime = reportTime = get_current_time();
+    for (int g = 1; g <= MULTIBOARD_GAMES; g++) {
+        seL4_Notify(games[g].request.cptr, 1);
+    }
+    return 0;
+}
+
+
+/*
+ * Print the number of games finished per second since multiboard_start().
+ */
+static void
+report_rate(uint64_t now) {
+    unsigned long total = 0;
+    for (int g = 1; g <= MULTIBOARD_GAMES; g++) {
+        total += games[g].games;
+    }
+    const uint64_t ms = (now - startTime) / NS_IN_MS;
+    // in hundredths
+    const unsigned long rate = ms ? total * 100000ULL / ms : 0;
+    printf("multi-board: %lu games in %llu ms, %lu.%02lu games/s\n", total,
+            (unsigned long long)ms, rate / 100, rate % 100);
+}
+
+
+void
+multiboard_present() {
+    // the game threads may draw while we wait for the vertical retrace
+    lock_screen();
+    gfx_present_copy();
+    unlock_screen();
+    gfx_present_flip();
+    const uint64_t now = get_current_time();
+    if (now - reportTime >= REPORT_TIME) {
+        report_rate(now);
+        reportTime = now;
+    }
+}
+
+
+/*
+ * Integer square root (rounded down).
+ */
+static uint64_t
+isqrt(uint64_t n) {
+    uint64_t r = 0;
+    for (uint64_t bit = 1ULL << 62; bit != 0; bit >>= 2) {
+        if (n >= r + bit) {
+            n -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+    }
+    return r;
+}
+
+
+void
+multiboard_stop() {
+    stop = 1;
+    for (int g = 1; g <= MULTIBOARD_GAMES; g++) {
+        seL4_Wait(games[g].done.cptr, NULL);
+    }
+    gfx_present();
+    report_rate(get_current_time());
+    printf("game  games  ticks  tick (cycles): mean  stddev     max"
+            "  lock wait\n");
+    for (int g = 1; g <= MULTIBOARD_GAMES; g++) {
+        const game_t* gm = &games[g];
+        uint64_t mean = 0;
+        uint64_t stddev = 0;
+        if (gm->ticks > 0) {
+            mean = gm->tickSum / gm->ticks;
+            double var = gm->tickSquares / gm->ticks - (double)mean * mean;
+            stddev = var > 0 ? isqrt((uint64_t)var) : 0;
+        }
+        printf("%4d %6lu %6lu %19llu %7llu %7llu %9llu\n", g, gm->games,
+                gm->ticks, (unsigned long long)mean,
+                (unsigned long long)stddev, (unsigned long long)gm->tickMax,
+                (unsigned long long)gm->lockWait);
+    }
+}
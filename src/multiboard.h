@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef MULTIBOARD_H_
+#define MULTIBOARD_H_
+
+#include <vka/vka.h>
+#include <vspace/vspace.h>
+#include <simple/simple.h>
+#include "tron.h"
+
+/*
+ * Set up the boards and computer players of games 1 to MULTIBOARD_GAMES, and
+ * start a thread for each game. Call after board_init() of game 0.
+ */
+void multiboard_init(vka_t* vka, vspace_t* vspace, simple_t* simple);
+
+/*
+ * Let the game threads play, each in its own tile of the screen, until
+ * multiboard_stop(). The screen must not be drawn on by anybody else (see
+ * render_sync()) in the meantime.
+ * @return: 0 if the games started; -1 if their boards do not fit on screen
+ */
+int multiboard_start();
+
+/*
+ * Show what the game threads have drawn so far; every few seconds, also
+ * print the number of games per second.
+ */
+void multiboard_present();
+
+/*
+ * Stop the game threads (after their current tick) and print the
+ * statistics of each game.
+ */
+void multiboard_stop();
+
+
+#endif /* MULTIBOARD_H_ */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Two instances of seL4Tron play one game over the second serial port
+ * (COM2), e.g. two QEMU VMs whose COM2 ports are joined by a socket.
+ * Each side plays one player with the keyboard and sends the direction
+ * of its player to the other side once per tick (one character: 'W',
+ * 'N', 'E', or 'S'; 'Q' when the game is cancelled). The game loop (see
+ * run_netgame() in main.c) does not wait for these; it predicts them and
+ * corrects itself when they arrive. Every so many ticks, each side also
+ * sends the hash of its board, so that the sides notice if their games
+ * have gone apart:
+ *
+ *   "C" <16 hex digits>       (board_hash() after the next checkpoint)
+ *
+ * Before a game, both sides exchange a hello message with a random
+ * number; the side with the larger number plays GREEN (p0):
+ *
+ *   "H" <8 hex digits> "\n"   (repeated until the other side's arrives)
+ *   "G"                       (we have the other side's hello)
+ *
+ * Everything after the "G" belongs to the game.
+ */
+
+#include <autoconf.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <assert.h>
+#include <platsupport/timer.h>
+#include "netplay.h"
+
+/* COM2; COM1 is the console */
+static ps_chardevice_t serial;
+static int initialized = 0;
+
+static const char* dirchars = "WNES";
+
+/* netplay_recv(): hex digits of a board hash being received (-1 outside
+ * of a hash), and their value */
+static int hashDigits;
+static uint64_t hashValue;
+
+
+void
+netplay_init(ps_io_ops_t* io_ops) {
+    if (initialized) {
+        return;
+    }
+    UNUSED ps_chardevice_t* dev = ps_cdev_init(PC99_SERIAL_COM2, io_ops,
+            &serial);
+    assert(dev != NULL);
+    initialized = 1;
+}
+
+
+static void
+send_hello(uint32_t nonce) {
+    char msg[16];
+    int n = snprintf(msg, sizeof(msg), "H%08x\n", (unsigned)nonce);
+    for (int i = 0; i < n; i++) {
+        ps_cdev_putchar(&serial, msg[i]);
+    }
+}
+
+
+/*
+ * Find the other side and decide who plays which player.
+ * @param timeout: give up after this many ns
+ * @return: index of the player this side plays; -1 if no other side
+ *          answered in time
+ */
+int
+netplay_connect(uint64_t timeout) {
+    assert(initialized);
+    const uint64_t resend = 100 * NS_IN_MS;
+    uint64_t now = get_current_time();
+    uint64_t endTime = now + timeout;
+    uint64_t nextHello = now;
+    uint32_t nonce = now ^ (now >> 32);
+    uint32_t remote = 0;
+    int haveRemote = 0;
+    /* hex digits of a hello being received; -1 outside of a hello */
+    int digits = -1;
+    uint32_t value = 0;
+
+    while ((now = get_current_time()) < endTime) {
+        if (!haveRemote && now >= nextHello) {
+            send_hello(nonce);
+            nextHello = now + resend;
+        }
+        int c = ps_cdev_getchar(&serial);
+        if (c == EOF) {
+            continue;
+        }
+        if (c == 'H') {
+            digits = 0;
+            value = 0;
+        } else if (digits >= 0 && digits < 8 && isxdigit(c)) {
+            value = value << 4 | (isdigit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+            digits++;
+        } else if (digits == 8 && c == '\n') {
+            digits = -1;
+            if (!haveRemote) {
+                remote = value;
+                haveRemote = 1;
+                // our hello may have been lost while the other side was
+                // not listening yet; once more, then we are ready
+                send_hello(nonce);
+                ps_cdev_putchar(&serial, 'G');
+            }
+        } else if (c == 'G' && haveRemote) {
+            if (remote == nonce) {
+                printf("netplay: both sides picked %08x; try again\n",
+                        (unsigned)nonce);
+                return -1;
+            }
+            printf("netplay: connected (%08x vs %08x)\n",
+                    (unsigned)nonce, (unsigned)remote);
+            hashDigits = -1;
+            return nonce > remote ? 0 : 1;
+        } else {
+            // garbage, e.g. of a game that has ended
+            digits = -1;
+        }
+    }
+    printf("netplay: no answer on COM2\n");
+    return -1;
+}
+
+
+void
+netplay_send(direction_t dir) {
+    ps_cdev_putchar(&serial, dirchars[dir]);
+}
+
+
+void
+netplay_send_quit() {
+    ps_cdev_putchar(&serial, 'Q');
+}
+
+
+void
+netplay_send_hash(uint64_t hash) {
+    char msg[24];
+    int n = snprintf(msg, sizeof(msg), "C%016llx", (unsigned long long)hash);
+    for (int i = 0; i < n; i++) {
+        ps_cdev_putchar(&serial, msg[i]);
+    }
+}
+
+
+/*
+ * Get the next direction or board hash the other side sent.
+ * @param hash: returns the board hash if NETPLAY_HASH is returned
+ * @return: a direction, NETPLAY_HASH, NETPLAY_QUIT, or NETPLAY_NONE
+ */
+int
+netplay_recv(uint64_t* hash) {
+    for (;;) {
+        int c = ps_cdev_getchar(&serial);
+        if (c == EOF) {
+            return NETPLAY_NONE;
+        }
+        if (hashDigits >= 0 && isxdigit(c) && !isupper(c)) {
+            hashValue = hashValue << 4
+                    | (isdigit(c) ? c - '0' : c - 'a' + 10);
+            if (++hashDigits == 16) {
+                hashDigits = -1;
+                *hash = hashValue;
+                return NETPLAY_HASH;
+            }
+            continue;
+        }
+        hashDigits = -1;
+        if (c == 'C') {
+            hashDigits = 0;
+            hashValue = 0;
+            continue;
+        }
+        if (c == 'Q') {
+            return NETPLAY_QUIT;
+        }
+        for (int dir = 0; dir < DirLength; dir++) {
+            if (c == dirchars[dir]) {
+                return dir;
+            }
+        }
+        // anything else is left over from the hello; skip it
+    }
+}
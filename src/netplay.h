@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef NETPLAY_H_
+#define NETPLAY_H_
+
+#include <sel4platsupport/io.h>
+#include "tron.h"
+
+/* netplay_recv(): nothing received yet, the other side quit, or it sent
+ * the hash of its board */
+#define NETPLAY_NONE -1
+#define NETPLAY_QUIT -2
+#define NETPLAY_HASH -3
+
+void netplay_init(ps_io_ops_t* io_ops);
+int netplay_connect(uint64_t timeout);
+void netplay_send(direction_t dir);
+void netplay_send_quit();
+void netplay_send_hash(uint64_t hash);
+int netplay_recv(uint64_t* hash);
+
+
+#endif /* NETPLAY_H_ */
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * A simple model of how the opponent moves, learned while playing: for
+ * every "context" we count how often the opponent moved forward, left, or
+ * right. The context is the occupancy of the three cells in front, to the
+ * left, and to the right of the opponent, plus the opponent's previous
+ * action (i.e. an n-gram over actions, conditioned on the surroundings).
+ *
+ * There is one model per player, updated by the AI of the other player
+ * only, so the AIs of both players can run at the same time. The model
+ * starts from scratch with every game, so that games can be replayed.
+ */
+
+#include <string.h>
+#include "oppmodel.h"
+
+/* occupancy (3 bits) x previous action */
+#define CONTEXTS (8 * OPP_ACTIONS)
+
+/* counts are halved when one gets this large, so that the model adapts */
+#define COUNT_MAX 1000
+
+typedef struct {
+    unsigned short counts[CONTEXTS][OPP_ACTIONS];
+    /* last observation: context, direction, and position of the opponent;
+     * valid if "observed" is set */
+    int observed;
+    int context;
+    direction_t dir;
+    coord_t pos;
+    /* action the opponent took last */
+    int action;
+} opp_model_t;
+
+/* models indexed by entity (CELL_P0, CELL_P1) - CELL_P0 */
+static opp_model_t models[MAX_GAMES][NUMPLAYERS];
+
+
+/*
+ * Cell next to pos when moving in direction dir.
+ */
+static coord_t
+neighbor(coord_t pos, direction_t dir) {
+    static const coord_t delta[] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+    return (coord_t){pos.x + delta[dir].x, pos.y + delta[dir].y};
+}
+
+
+/*
+ * Relative action that turns direction "from" into direction "to".
+ * @return: 0 forward, 1 left, 2 right; -1 turned around (impossible)
+ */
+static int
+get_action(direction_t from, direction_t to) {
+    static const int turn[] = {0, 2, -1, 1};
+    return turn[(to - from + DirLength) % DirLength];
+}
+
+
+/*
+ * Context of a player at position pos, facing dir, who took action
+ * "action" last.
+ */
+static int
+get_context(coord_t pos, direction_t dir, int action) {
+    int f = !isempty_cell(neighbor(pos, dir));
+    int l = !isempty_cell(neighbor(pos, (dir + DirLength - 1) % DirLength));
+    int r = !isempty_cell(neighbor(pos, (dir + 1) % DirLength));
+    return (f | l << 1 | r << 2) * OPP_ACTIONS + action;
+}
+
+
+/*
+ * Called at the beginning of a game: forget everything.
+ */
+void
+opp_model_newgame() {
+    memset(models[get_game()], 0, sizeof(models[0]));
+}
+
+
+/*
+ * Observe opponent "you": learn from the move it made since the last
+ * observation. Called once per tick by the AI of the other player.
+ */
+void
+opp_model_observe(const player_t* you) {
+    opp_model_t* m = &models[get_game()][you->entity - CELL_P0];
+    if (m->observed
+    && (m->pos.x != you->pos.x || m->pos.y != you->pos.y)) {
+        int action = get_action(m->dir, you->direction);
+        if (action >= 0) {
+            unsigned short* c = m->counts[m->context];
+            if (++c[action] >= COUNT_MAX) {
+                for (int a = 0; a < OPP_ACTIONS; a++) {
+                    c[a] /= 2;
+                }
+            }
+            m->action = action;
+        }
+    }
+    m->observed = 1;
+    m->pos = you->pos;
+    m->dir = you->direction;
+    m->context = get_context(you->pos, you->direction, m->action);
+}
+
+
+/*
+ * Predict the next action of opponent "you" (call opp_model_observe()
+ * first).
+ * @param probs: returns the probability (fixed point; OPP_ONE is 1.0) of
+ *               moving forward, left, and right
+ * @return: number of observations the prediction is based on
+ */
+int
+opp_model_predict(const player_t* you, int probs[OPP_ACTIONS]) {
+    opp_model_t* m = &models[get_game()][you->entity - CELL_P0];
+    unsigned short* c = m->counts[m->context];
+    int total = 0;
+    for (int a = 0; a < OPP_ACTIONS; a++) {
+        total += c[a];
+    }
+    for (int a = 0; a < OPP_ACTIONS; a++) {
+        // add-one smoothing
+        probs[a] = (c[a] + 1) * OPP_ONE / (total + OPP_ACTIONS);
+    }
+    return total;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef OPPMODEL_H_
+#define OPPMODEL_H_
+
+#include "tron.h"
+
+/* number of relative actions: forward, left, right (as action_t) */
+#define OPP_ACTIONS 3
+
+/* probabilities are fixed point: OPP_ONE is 1.0 */
+#define OPP_ONE 256
+
+void opp_model_newgame();
+void opp_model_observe(const player_t* you);
+int opp_model_predict(const player_t* you, int probs[OPP_ACTIONS]);
+
+
+#endif /* OPPMODEL_H_ */
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Drawing happens on a thread of its own (the render thread), so that
+ * the game loop does not wait for the frame buffer. The game loop puts
+ * drawing commands into a ring buffer and goes on; the render thread
+ * executes them in order, while the game loop waits for the timer.
+ *
+ * The kernel this app is built against runs on a single core and has no
+ * way to pin a thread to a core: the render thread time-shares the core
+ * with the main thread (and the AI threads), so it draws in the time the
+ * game loop would otherwise sleep, not in parallel with the search.
+ *
+ * The ring has one producer (the main thread) and one consumer (the
+ * render thread), so it needs no lock: only the producer moves tail and
+ * only the consumer moves head. The render thread sleeps on an async
+ * endpoint (notification) while the ring is empty; the main thread
+ * signals it once per frame (render_present()), and whenever the ring is
+ * full.
+ *
+ * The render thread is the only one that touches the frame buffer (and
+ * graphics.c's state) once it runs. It must not allocate memory, because
+ * vka and vspace are not thread safe; images have to be loaded before
+ * (see gfx_load_ppm()).
+ */
+
+#include <autoconf.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sel4/sel4.h>
+#include <sel4utils/thread.h>
+#include <vka/object.h>
+#include "graphics.h"
+#include "render.h"
+#include "memstat.h"
+#include "tron.h"
+
+typedef enum {
+    CMD_RECT,
+    CMD_FILL,
+    CMD_SAVE,
+    CMD_RESTORE,
+    CMD_PPM,
+    CMD_PRESENT,
+    CMD_SYNC
+} cmd_op_t;
+
+/* a drawing command; 32 bytes (on 32 bit machines) */
+typedef struct {
+    uint8_t op;
+    int16_t x;
+    int16_t y;
+    int16_t w;
+    int16_t h;
+    union {
+        /* CMD_RECT, CMD_FILL */
+        uint32_t color;
+        /* CMD_SAVE, CMD_RESTORE */
+        uint32_t* buf;
+        /* CMD_PPM */
+        struct {
+            float opacity;
+            char name[16];
+        } ppm;
+    };
+} cmd_t;
+
+/* must be a power of two */
+#define RING_LEN 256
+
+static cmd_t ring[RING_LEN];
+
+/* next command to execute (render thread) and next free slot (main
+ * thread); both only ever grow, and wrap around at 2^32 */
+static uint32_t head = 0;
+static uint32_t tail = 0;
+
+static sel4utils_thread_t thread;
+
+/* the main thread signals that there are commands in the ring */
+static vka_object_t work;
+
+/* the render thread signals that it has executed CMD_SYNC */
+static vka_object_t synced;
+
+/* set once the render thread runs */
+static int running = 0;
+
+/* statistics, for render_get_stats() */
+static int maxDepth = 0;
+static int stalls = 0;
+
+
+static void
+execute(const cmd_t* cmd) {
+    switch (cmd->op) {
+    case CMD_RECT:
+        gfx_draw_rect(cmd->x, cmd->y, cmd->w, cmd->h, cmd->color);
+        break;
+    case CMD_FILL:
+        gfx_fill_screen(cmd->color);
+        break;
+    case CMD_SAVE:
+        gfx_save_rect(cmd->x, cmd->y, cmd->w, cmd->h, cmd->buf);
+        break;
+    case CMD_RESTORE:
+        gfx_restore_rect(cmd->x, cmd->y, cmd->w, cmd->h, cmd->buf);
+        break;
+    case CMD_PPM:
+        gfx_diplay_ppm(cmd->x, cmd->y, cmd->ppm.name, cmd->ppm.opacity);
+        break;
+    case CMD_PRESENT:
+        gfx_present();
+        break;
+    case CMD_SYNC:
+        seL4_Notify(synced.cptr, 1);
+        break;
+    default:
+        assert(!"invalid render command");
+    }
+}
+
+
+/*
+ * Entry point of the render thread: execute commands forever.
+ */
+static void
+render_thread_run(UNUSED void* arg0, UNUSED void* arg1, UNUSED void* ipc_buf) {
+    for (;;) {
+        seL4_Wait(work.cptr, NULL);
+        uint32_t h = head;
+        while (h != __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) {
+            execute(&ring[h % RING_LEN]);
+            h++;
+            // the slot may be reused from now on
+            __atomic_store_n(&head, h, __ATOMIC_RELEASE);
+        }
+    }
+}
+
+
+/*
+ * Append command "cmd" to the ring (or execute it, if there is no render
+ * thread). Wait while the ring is full.
+ * @param wakeup: signal the render thread
+ */
+static void
+post(const cmd_t* cmd, int wakeup) {
+    if (!running) {
+        execute(cmd);
+        return;
+    }
+    if (tail - __atomic_load_n(&head, __ATOMIC_ACQUIRE) == RING_LEN) {
+        stalls++;
+        do {
+            seL4_Notify(work.cptr, 1);
+            seL4_Yield();
+        } while (tail - __atomic_load_n(&head, __ATOMIC_ACQUIRE) == RING_LEN);
+    }
+    ring[tail % RING_LEN] = *cmd;
+    __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+
+    int depth = tail - __atomic_load_n(&head, __ATOMIC_RELAXED);
+    if (depth > maxDepth) {
+        maxDepth = depth;
+    }
+    if (wakeup) {
+        seL4_Notify(work.cptr, 1);
+    }
+}
+
+
+/*
+ * Create and start the render thread.
+ */
+void
+render_init(vka_t* vka, vspace_t* vspace, simple_t* simple) {
+    UNUSED int err = vka_alloc_async_endpoint(vka, &work);
+    assert(err == 0);
+    err = vka_alloc_async_endpoint(vka, &synced);
+    assert(err == 0);
+
+    err = sel4utils_configure_thread(vka, vspace, vspace, seL4_CapNull,
+            seL4_MaxPrio, simple_get_cnode(simple), seL4_NilData, &thread);
+    assert(err == 0);
+    memstat_add_stack("render thread", thread.stack_top);
+    err = sel4utils_start_thread(&thread, render_thread_run, NULL, NULL, 1);
+    assert(err == 0);
+    running = 1;
+    printf("started render thread (%d commands of %d bytes)\n",
+            RING_LEN, (int)sizeof(cmd_t));
+}
+
+
+void
+render_rect(int x, int y, int w, int h, uint32_t c) {
+    cmd_t cmd = { .op = CMD_RECT, .x = x, .y = y, .w = w, .h = h,
+            .color = c };
+    post(&cmd, 0);
+}
+
+
+void
+render_fill(uint32_t c) {
+    cmd_t cmd = { .op = CMD_FILL, .color = c };
+    post(&cmd, 0);
+}
+
+
+void
+render_save(int x, int y, int w, int h, uint32_t* buf) {
+    cmd_t cmd = { .op = CMD_SAVE, .x = x, .y = y, .w = w, .h = h,
+            .buf = buf };
+    post(&cmd, 0);
+}
+
+
+void
+render_restore(int x, int y, int w, int h, const uint32_t* buf) {
+    // never written through; see execute()
+    cmd_t cmd = { .op = CMD_RESTORE, .x = x, .y = y, .w = w, .h = h,
+            .buf = (uint32_t*)buf };
+    post(&cmd, 0);
+}
+
+
+void
+render_ppm(int x, int y, const char* filename, float opacity) {
+    cmd_t cmd = { .op = CMD_PPM, .x = x, .y = y };
+    assert(strlen(filename) < sizeof(cmd.ppm.name));
+    strcpy(cmd.ppm.name, filename);
+    cmd.ppm.opacity = opacity;
+    post(&cmd, 0);
+}
+
+
+void
+render_present() {
+    cmd_t cmd = { .op = CMD_PRESENT };
+    post(&cmd, 1);
+}
+
+
+void
+render_sync() {
+    if (!running) {
+        return;
+    }
+    cmd_t cmd = { .op = CMD_SYNC };
+    post(&cmd, 1);
+    seL4_Wait(synced.cptr, NULL);
+}
+
+
+void
+render_get_stats(int* depth, int* max, int* numStalls) {
+    *depth = tail - __atomic_load_n(&head, __ATOMIC_RELAXED);
+    *max = maxDepth;
+    *numStalls = stalls;
+    maxDepth = stalls = 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include <vka/vka.h>
+#include <vspace/vspace.h>
+#include <simple/simple.h>
+
+/*
+ * Start the render thread. Until then (or without it), every render_*()
+ * call below draws right away, like the gfx_*() function it stands for.
+ */
+void render_init(vka_t* vka, vspace_t* vspace, simple_t* simple);
+
+/*
+ * Queue a drawing command for the render thread; see graphics.h for
+ * the meaning of the arguments. Buffers passed to render_save() and
+ * render_restore() must stay valid until the command has been executed.
+ */
+void render_rect(int x, int y, int w, int h, uint32_t c);
+void render_fill(uint32_t c);
+void render_save(int x, int y, int w, int h, uint32_t* buf);
+void render_restore(int x, int y, int w, int h, const uint32_t* buf);
+void render_ppm(int x, int y, const char* filename, float opacity);
+void render_present();
+
+/*
+ * Wait until the render thread has executed all queued commands.
+ */
+void render_sync();
+
+/*
+ * Get the number of queued commands, the largest number seen since the
+ * last call, and how often the queue was full since the last call.
+ */
+void render_get_stats(int* depth, int* maxDepth, int* stalls);
+
+
+#endif /* RENDER_H_ */
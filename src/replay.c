@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Recording and playback of games. A game is fully determined by the game
+ * mode, the seeds of the computer players' random number generators, and
+ * the direction changes and turbo boosts of the players; so that is all we
+ * record:
+ *
+ *   header:  "TRRP", version, mode (number of human players), cell width,
+ *            flags (REPLAY_*), numCellsX (16 bit), numCellsY (16 bit),
+ *            NUMPLAYERS seeds (32 bit); all numbers are little endian
+ *   events:  one byte per direction change: bits 0-1 direction,
+ *            bit 2 player, bits 3-7 number of ticks since previous event;
+ *            ticks = 30 means the actual number follows as a LEB128 varint,
+ *            ticks = 31 marks the end of the events; ticks = 29 (version 2)
+ *            marks a turbo boost of the player, the number of ticks follows
+ *            as a varint
+ *   trailer: number of ticks (32 bit), player that crashed (8 bit; 0xff if
+ *            the game was canceled), hash of the final board (32 bit)
+ *
+ * The last recorded game is kept in memory. It can be printed (hex) over
+ * the serial line, converted to binary with "xxd -r -p", and packed into
+ * the cpio archive as "replay.trr" (see Makefile) to play it back later.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <utils/util.h>
+#include <assert.h>
+#include "replay.h"
+
+#define REPLAY_VERSION 2
+
+/* size of the header and of the trailer (bytes) */
+#define HEADER_LEN (12 + 4 * NUMPLAYERS)
+#define TRAILER_LEN 9
+
+/* size of the replay buffer (bytes) */
+#define REPLAY_LEN (64 * 1024)
+
+/* event tick values with special meaning (see above) */
+#define TICKS_TURBO 29
+#define TICKS_VARINT 30
+#define TICKS_END 31
+
+/* the replay buffer */
+static uint8_t* buf = NULL;
+
+/* number of valid bytes in buf; 0 means there is no replay */
+static size_t len = 0;
+
+/* recording: next write position; tick of the last event; buffer overflow */
+static size_t wpos;
+static int wtick;
+static int truncated;
+
+/* playback: format version; next read position; next event (tick < 0 if
+ * none decoded) */
+static int version;
+static size_t rpos;
+static int rtick;
+static int evtick;
+static int evpl;
+static int evdir;
+static int evturbo;
+
+
+/*
+ * Allocate the replay buffer.
+ */
+void
+replay_init() {
+    buf = alloc_pages(REPLAY_LEN);
+}
+
+
+static void
+put8(uint8_t v) {
+    if (wpos < REPLAY_LEN) {
+        buf[wpos++] = v;
+    } else {
+        truncated = 1;
+    }
+}
+
+
+static void
+put32(uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        put8(v >> (8 * i));
+    }
+}
+
+
+static uint32_t
+get32(size_t pos) {
+    return buf[pos] | buf[pos + 1] << 8 | buf[pos + 2] << 16
+            | (uint32_t)buf[pos + 3] << 24;
+}
+
+
+/*
+ * Hash (FNV-1a) over all cells of the board.
+ */
+uint32_t
+replay_board_hash() {
+    uint32_t h = 2166136261u;
+    for (int y = 0; y < numCellsY; y++) {
+        for (int x = 0; x < numCellsX; x++) {
+            h = (h ^ get_cell((coord_t){x, y})) * 16777619u;
+        }
+    }
+    return h;
+}
+
+
+/*
+ * Start recording a new game (which discards the previous recording).
+ */
+void
+replay_record_start(int numPl, int flags, const uint32_t seeds[NUMPLAYERS]) {
+    len = wpos = 0;
+    wtick = 0;
+    truncated = 0;
+    put8('T'); put8('R'); put8('R'); put8('P');
+    put8(REPLAY_VERSION);
+    put8(numPl);
+    put8(cellWidth);
+    put8(flags);
+    put8(numCellsX & 0xff); put8(numCellsX >> 8);
+    put8(numCellsY & 0xff); put8(numCellsY >> 8);
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        put32(seeds[i]);
+    }
+}
+
+
+/*
+ * Record event byte "ev" in tick "step", the number of ticks since the
+ * previous event following as a varint.
+ */
+static void
+record_varint(int step, uint8_t ev) {
+    int ticks = step - wtick;
+    wtick = step;
+    put8(ev);
+    do {
+        put8((ticks & 0x7f) | (ticks >= 0x80 ? 0x80 : 0));
+        ticks >>= 7;
+    } while (ticks);
+}
+
+
+/*
+ * Record that player "pl" moves in direction "dir" in tick "step".
+ */
+void
+replay_record_dir(int step, int pl, direction_t dir) {
+    int ticks = step - wtick;
+    uint8_t ev = (pl << 2) | dir;
+    if (ticks < TICKS_TURBO) {
+        wtick = step;
+        put8(ticks << 3 | ev);
+        return;
+    }
+    record_varint(step, TICKS_VARINT << 3 | ev);
+}
+
+
+/*
+ * Record that player "pl" starts a turbo boost in tick "step".
+ */
+void
+replay_record_turbo(int step, int pl) {
+    record_varint(step, TICKS_TURBO << 3 | pl << 2);
+}
+
+
+/*
+ * Finish recording; "loser" is the player that crashed (-1 if the game
+ * was canceled).
+ */
+void
+replay_record_end(int steps, int loser) {
+    put8(TICKS_END << 3);
+    put32(steps);
+    put8(loser < 0 ? 0xff : loser);
+    put32(replay_board_hash());
+    if (truncated) {
+        printf("replay: game too long; recording discarded\n");
+        return;
+    }
+    len = wpos;
+}
+
+
+/*
+ * Check header of replay in buf.
+ * @return: 0 if replay in buf can be played on the current board
+ */
+static int
+check_header(size_t size) {
+    if (size < HEADER_LEN || memcmp(buf, "TRRP", 4) != 0
+    || buf[4] < 1 || buf[4] > REPLAY_VERSION) {
+        printf("replay: invalid format\n");
+        return -1;
+    }
+    int x = buf[8] | buf[9] << 8;
+    int y = buf[10] | buf[11] << 8;
+    if (x != numCellsX || y != numCellsY) {
+        printf("replay: recorded on a %d x %d board; this board is %d x %d\n",
+                x, y, numCellsX, numCellsY);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Decode the event at *pos, reading no further than "end".
+ * @param ev: returns the event byte
+ * @param ticks: returns the number of ticks since the previous event
+ * @return: 0 event; 1 end marker; -1 malformed (the event runs past end,
+ *          or its number of ticks does not fit in an int)
+ */
+static int
+decode_event(size_t* pos, size_t end, int ver, uint8_t* ev, int* ticks) {
+    if (*pos >= end) {
+        return -1;
+    }
+    *ev = buf[(*pos)++];
+    int t = *ev >> 3;
+    if (t == TICKS_END) {
+        return 1;
+    }
+    if (t == TICKS_VARINT || (t == TICKS_TURBO && ver >= 2)) {
+        uint32_t value = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            // the fifth byte may only hold the top 3 of 31 bits
+            if (*pos >= end || shift > 28) {
+                return -1;
+            }
+            b = buf[(*pos)++];
+            if (shift == 28 && (b & 0x78)) {
+                return -1;
+            }
+            value |= (uint32_t)(b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        t = value;
+    }
+    *ticks = t;
+    return 0;
+}
+
+
+/*
+ * Check the whole replay in buf, not just its header: playback trusts it.
+ * The fields have to be in range, and the events have to decode and end
+ * with the end marker right before the trailer.
+ * @return: 0 if the replay can be played back on the current board
+ */
+static int
+check_replay(size_t size) {
+    if (check_header(size) != 0) {
+        return -1;
+    }
+    const char* err = NULL;
+    if (size < HEADER_LEN + 1 + TRAILER_LEN) {
+        err = "file truncated";
+    } else if (buf[5] > NUMPLAYERS) {
+        err = "invalid number of players";
+    } else if (buf[7] >> REPLAY_LEVEL_SHIFT >= AI_LEVELS) {
+        err = "invalid level";
+    } else {
+        const size_t end = size - TRAILER_LEN;
+        size_t pos = HEADER_LEN;
+        int64_t tick = 0;
+        uint8_t ev;
+        int ticks;
+        int r;
+        while ((r = decode_event(&pos, end, buf[4], &ev, &ticks)) == 0
+        && (tick += ticks) <= INT_MAX) {
+            continue;
+        }
+        const int loser = buf[end + 4];
+        if (r != 1 || pos != end) {
+            err = "invalid events";
+        } else if (get32(end) > INT_MAX
+        || (loser >= NUMPLAYERS && loser != 0xff)) {
+            err = "invalid trailer";
+        }
+    }
+    if (err != NULL) {
+        printf("replay: %s\n", err);
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Make the replay in "data" the current replay.
+ * @return: 0 okay; -1 replay cannot be used
+ */
+int
+replay_load(const void* data, size_t size) {
+    if (size > REPLAY_LEN) {
+        printf("replay: file too large\n");
+        return -1;
+    }
+    memcpy(buf, data, size);
+    len = check_replay(size) == 0 ? size : 0;
+    return len ? 0 : -1;
+}
+
+
+/*
+ * Print the current replay (hex) to stdout.
+ */
+void
+replay_dump() {
+    printf("--- replay: %u bytes ---\n", (unsigned)len);
+    for (size_t i = 0; i < len; i++) {
+        printf("%02x%s", buf[i], (i % 32 == 31 || i == len - 1) ? "\n" : "");
+    }
+    printf("--- replay end ---\n");
+}
+
+
+/*
+ * Decode the next event at rpos into evtick, evpl, evdir.
+ */
+static void
+next_event() {
+    uint8_t ev;
+    int ticks;
+    // the replay has been checked (see check_replay())
+    UNUSED int r = decode_event(&rpos, len - TRAILER_LEN, version, &ev,
+            &ticks);
+    assert(r >= 0);
+    if (r == 1) {
+        rpos--; // stay at end marker
+        evtick = -1;
+        return;
+    }
+    evturbo = ev >> 3 == TICKS_TURBO && version >= 2;
+    rtick += ticks;
+    evtick = rtick;
+    evpl = (ev >> 2) & 1;
+    evdir = ev & 3;
+}
+
+
+/*
+ * Start playing back the current replay.
+ * @param numPl: returns number of human players of the recorded game
+ * @param flags: returns flags (REPLAY_*) of the recorded game
+ * @param seeds: returns seeds of the players' random number generators
+ * @return: 0 okay; -1 there is no replay
+ */
+int
+replay_play_start(int* numPl, int* flags, uint32_t seeds[NUMPLAYERS]) {
+    if (len == 0 || check_replay(len) != 0) {
+        printf("replay: nothing to play\n");
+        return -1;
+    }
+    version = buf[4];
+    *numPl = buf[5];
+    *flags = buf[7];
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        seeds[i] = get32(12 + 4 * i);
+    }
+    rpos = HEADER_LEN;
+    rtick = 0;
+    next_event();
+    return 0;
+}
+
+
+/*
+ * Get the direction player "pl" changed to in tick "step".
+ * @return: new direction; -1 if there was no recorded change
+ */
+int
+replay_play_dir(int step, int pl) {
+    if (evtick != step || evpl != pl || evturbo) {
+        return -1;
+    }
+    int dir = evdir;
+    next_event();
+    return dir;
+}
+
+
+/*
+ * Check whether player "pl" started a turbo boost in tick "step"; call
+ * before replay_play_dir() for the same tick.
+ * @return: 1 if so; 0 otherwise
+ */
+int
+replay_play_turbo(int step, int pl) {
+    if (evtick != step || evpl != pl || !evturbo) {
+        return 0;
+    }
+    next_event();
+    return 1;
+}
+
+
+/*
+ * Number of ticks of the recorded game.
+ */
+int
+replay_play_steps() {
+    size_t pos = len - TRAILER_LEN;
+    return get32(pos);
+}
+
+
+/*
+ * Compare the outcome of the game played back with the recorded outcome.
+ * @return: 0 outcome matches; 1 outcome differs
+ */
+int
+replay_play_end(int steps, int loser) {
+    size_t pos = len - TRAILER_LEN;
+    int rsteps = get32(pos);
+    int rloser = buf[pos + 4] == 0xff ? -1 : buf[pos + 4];
+    uint32_t rhash = get32(pos + 5);
+    uint32_t hash = replay_board_hash();
+    int differs = (steps != rsteps || loser != rloser || hash != rhash);
+    printf("replay: %s (ticks %d/%d, crashed %d/%d, board %08x/%08x)\n",
+            differs ? "MISMATCH" : "match",
+            steps, rsteps, loser, rloser, hash, rhash);
+    return differs;
+}
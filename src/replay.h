@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tron.h"
+
+/* flags of a recorded game */
+/* computer players decided on their moves on the same board (aithread.c) */
+#define REPLAY_SNAPSHOT 1
+/* ticks are counted in halves, so that players can move at different
+ * speeds (see run_game()); not set in games recorded before */
+#define REPLAY_HALF_TICKS 2
+/* bits 4-7: difficulty level of the computer players (0 in games recorded
+ * before there were levels, which is right: they were limited by time) */
+#define REPLAY_LEVEL_SHIFT 4
+
+void replay_init();
+int replay_load(const void* data, size_t size);
+void replay_dump();
+
+void replay_record_start(int numPl, int flags, const uint32_t seeds[NUMPLAYERS]);
+void replay_record_dir(int step, int pl, direction_t dir);
+void replay_record_turbo(int step, int pl);
+void replay_record_end(int steps, int loser);
+
+int replay_play_start(int* numPl, int* flags, uint32_t seeds[NUMPLAYERS]);
+int replay_play_steps();
+int replay_play_dir(int step, int pl);
+int replay_play_turbo(int step, int pl);
+int replay_play_end(int steps, int loser);
+
+uint32_t replay_board_hash();
+
+
+#endif /* REPLAY_H_ */
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Event scheduler of the game loop: a priority queue (binary heap) of
+ * events, ordered by the time the event is due (in ticks, or fractions
+ * of ticks; see run_game()). Events that are due at the same time come
+ * out in the order of their ids, so that, e.g., player 0 still moves
+ * before player 1 when both are due. The queue holds one event per
+ * player, so it is small.
+ */
+
+#include <assert.h>
+#include "tron.h"
+#include "sched.h"
+
+/* maximum number of pending events */
+#define MAX_EVENTS 8
+
+typedef struct {
+    int due;
+    int id;
+} event_t;
+
+static event_t heap[MAX_EVENTS];
+static int numEvents = 0;
+
+
+static int
+before(const event_t* a, const event_t* b) {
+    return a->due < b->due || (a->due == b->due && a->id < b->id);
+}
+
+
+/*
+ * Drop all pending events.
+ */
+void
+sched_reset() {
+    numEvents = 0;
+}
+
+
+/*
+ * Schedule event "id" for time "due".
+ */
+void
+sched_push(int due, int id) {
+    assert(numEvents < MAX_EVENTS);
+    int i = numEvents++;
+    event_t ev = { due, id };
+    while (i > 0 && before(&ev, &heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = ev;
+}
+
+
+/*
+ * @return: time the next event is due; -1 if there are no events
+ */
+int
+sched_next() {
+    return numEvents > 0 ? heap[0].due : -1;
+}
+
+
+/*
+ * Remove the next event.
+ * @param id: returns the id of the event
+ * @return: time the event is due; -1 if there are no events
+ */
+int
+sched_pop(int* id) {
+    if (numEvents == 0) {
+        return -1;
+    }
+    event_t top = heap[0];
+    event_t last = heap[--numEvents];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= numEvents) {
+            break;
+        }
+        if (c + 1 < numEvents && before(&heap[c + 1], &heap[c])) {
+            c++;
+        }
+        if (!before(&heap[c], &last)) {
+            break;
+        }
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    *id = top.id;
+    return top.due;
+}
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+void sched_reset();
+void sched_push(int due, int id);
+int sched_next();
+int sched_pop(int* id);
+
+
+#endif /* SCHED_H_ */
@@ -10,25 +10,52 @@
 #ifndef TRON_H_
 #define TRON_H_
 
+#include <autoconf.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* number of players: (this game was designed for 0, 1, or 2 human players) */
 #define NUMPLAYERS 2
 
-/* size of the game board in pixels; hard-coded values to keep code simple */
-#define XRES 640
-#define YRES 480
+/* difficulty levels of the computer players (see gameai.c) */
+#define AI_LEVELS 4
 
-/* width (and height) of a "cell" (the game board is divided into "cells") */
-#define cellWidth 10
+/* number of games that can be played at the same time: the game of the
+ * start screen (game 0), the games of the multi-board mode (1 to
+ * MULTIBOARD_GAMES), and the AI domain's copy of game 0 (AI_DOMAIN_GAME;
+ * see aidomain.c) */
+#ifdef CONFIG_APP_TRON_MULTIBOARD
+#define MULTIBOARD_GAMES CONFIG_APP_TRON_MULTIBOARD_GAMES
+#else
+#define MULTIBOARD_GAMES 0
+#endif
+#ifdef CONFIG_APP_TRON_AI_DOMAIN
+#define AI_DOMAIN_GAME (1 + MULTIBOARD_GAMES)
+#define MAX_GAMES (2 + MULTIBOARD_GAMES)
+#else
+#define MAX_GAMES (1 + MULTIBOARD_GAMES)
+#endif
+
+/* minimum size of the screen in pixels; this used to be the fixed size of
+   the game board, which is now derived from the screen at startup */
+#define MIN_XRES 640
+#define MIN_YRES 480
+
+/* width (and height) of a "cell" (the game board is divided into "cells");
+   set at startup, see init_board() */
+extern int cellWidth;
 
 /* The line width of the trail the players leave behind as they move around.
-   Must be less than or equal to cellWidth and an even number. */
-#define lineWidth 6
+   Less than or equal to cellWidth and an even number. */
+extern int lineWidth;
+
+/* The number of cells on the board in x and y; set at startup */
+extern int numCellsX;
+extern int numCellsY;
 
-/* The number of cells on the board in x and y */
-#define numCellsX (XRES / cellWidth)
-#define numCellsY (YRES / cellWidth)
+/* size of the game board in pixels */
+#define XRES (numCellsX * cellWidth)
+#define YRES (numCellsY * cellWidth)
 
 typedef struct coord {
     int x;
@@ -51,17 +78,61 @@ typedef struct player {
     char* name;
     /* player's current score */
     int score;
+    /* state of the random number generator of a computer player */
+    uint32_t rng;
 } player_t;
 
 
 int get_loglevel();
 uint64_t get_current_time();
+void* alloc_pages(size_t size);
 void init_computer_move();
+void forget_computer_upkeep();
+void share_computer_board(int shared);
 direction_t get_computer_move(uint64_t endTime, player_t* me, player_t* you);
+unsigned long get_computer_work(player_t* me);
+void set_computer_level(int level);
+int get_computer_level();
+const char* get_computer_level_name(int level);
+int is_computer_level_timed(int level);
+int rules_load(const char* text, size_t size);
+int rules_save(char* text, size_t size);
+int get_computer_params(int* params, int max);
+void set_computer_params(const int* params);
+int poll_during_search(uint64_t endTime);
 cell_t get_cell(const coord_t pos);
 void put_board(const coord_t pos, cell_t element);
 int isempty_cell(const coord_t pos);
 
+/*
+ * Read the CPU's time stamp counter (cycles).
+ */
+static inline uint64_t
+read_tsc() {
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/*
+ * The game the calling thread plays. Every game has a board (board.c) and
+ * computer players (gameai.c) of its own. Threads keep the game in the
+ * user data word of their IPC buffer, which is 0 unless they set it (see
+ * multiboard.c).
+ */
+#if MAX_GAMES > 1
+#include <sel4/sel4.h>
+static inline int
+get_game() {
+    return seL4_GetUserData();
+}
+#else
+static inline int
+get_game() {
+    return 0;
+}
+#endif
+
 #define dprintf(...) if (get_loglevel() >= 1) fprintf (stdout, __VA_ARGS__)
 
 #endif /* TRON_H_ */
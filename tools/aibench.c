@@ -0,0 +1,389 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * AI benchmark runner: feeds positions from position files (see below) to
+ * get_computer_move() and reports speed (nodes = board cells visited by
+ * the AI) and quality (share of safe and best moves).
+ *
+ * Usage: aibench [-r runs] [-l level] [-b budget_us] [-e weights]
+ *                [-R rules] [-v] file...
+ *
+ * The AI plays at difficulty level "level" (see src/gameai.c; default:
+ * the game's default). Except at level 0, which searches for budget_us
+ * per move, the moves and the work do not depend on the host.
+ *
+ * With -e, the evaluation function (src/evaluate.c) is loaded from file
+ * "weights" and its cost in cycles per evaluated position is reported;
+ * then the positions are run again without it, for comparison. With -R,
+ * the rules of the computer player are loaded from file "rules" (see
+ * rules_load() in src/gameai.c), as the game does with data/rules.txt.
+ *
+ * Every position is evaluated "runs" times with different random seeds,
+ * because the AI picks moves at random from the matching rules.
+ *
+ * Position file format (one position per "position" ... "end" block;
+ * lines starting with '#' are comments, except within the board):
+ *
+ *   position <name>
+ *   size <width> <height>
+ *   board
+ *   <height lines of width characters: '#' wall, '.' empty,
+ *    'g' trail of GREEN (p0), 'b' trail of BLUE (p1)>
+ *   p0 <x> <y> <direction>
+ *   p1 <x> <y> <direction>
+ *   tomove p0|p1
+ *   safe <directions>       (optional; moves that do not lose)
+ *   best <direction>        (optional; the known best move)
+ *   end
+ *
+ * Directions are written as W, N, E, S.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "board.h"
+#include "board_shim.h"
+#include "evaluate.h"
+#include "oppmodel.h"
+
+#define MAX_POSITIONS 256
+#define NAME_LEN 64
+
+typedef struct {
+    char name[NAME_LEN];
+    int w;
+    int h;
+    /* board as read from file; w * h characters */
+    char* cells;
+    player_t pl[NUMPLAYERS];
+    /* index of player to move */
+    int tomove;
+    /* bit set of safe directions; 0 if not given */
+    int safe;
+    /* best direction; -1 if not given */
+    int best;
+} position_t;
+
+static position_t positions[MAX_POSITIONS];
+static int numPositions = 0;
+
+static const char* dirchars = "WNES";
+
+
+static int
+parse_dir(const char* s) {
+    const char* c = s ? strchr(dirchars, s[0]) : NULL;
+    return (c && *c) ? c - dirchars : -1;
+}
+
+
+static void
+fail(const char* file, int line, const char* msg) {
+    fprintf(stderr, "%s:%d: %s\n", file, line, msg);
+    exit(EXIT_FAILURE);
+}
+
+
+/*
+ * Read all positions from file "file" into positions[].
+ */
+static void
+load_positions(const char* file) {
+    FILE* f = fopen(file, "r");
+    if (f == NULL) {
+        perror(file);
+        exit(EXIT_FAILURE);
+    }
+    char line[1024];
+    int lineno = 0;
+    position_t* p = NULL;
+    int row = -1;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = 0;
+        if (row >= 0) {
+            // reading board lines (walls are '#', so no comments here)
+            if ((int)strlen(line) != p->w) {
+                fail(file, lineno, "board line has wrong length");
+            }
+            memcpy(p->cells + row * p->w, line, p->w);
+            row = (row + 1 < p->h) ? row + 1 : -1;
+            continue;
+        }
+        if (line[0] == '#' || line[0] == 0) {
+            continue;
+        }
+        char key[32];
+        char a[NAME_LEN] = "";
+        char b[32] = "";
+        char c[32] = "";
+        int n = sscanf(line, "%31s %63s %31s %31s", key, a, b, c);
+        if (n < 1) {
+            continue;
+        }
+        if (strcmp(key, "position") == 0) {
+            if (numPositions == MAX_POSITIONS) {
+                fail(file, lineno, "too many positions");
+            }
+            p = &positions[numPositions];
+            memset(p, 0, sizeof(*p));
+            snprintf(p->name, NAME_LEN, "%s", a);
+            p->best = -1;
+            continue;
+        }
+        if (p == NULL) {
+            fail(file, lineno, "expected \"position\"");
+        }
+        if (strcmp(key, "size") == 0) {
+            p->w = atoi(a);
+            p->h = atoi(b);
+            if (p->w < 3 || p->h < 3) {
+                fail(file, lineno, "invalid size");
+            }
+            p->cells = malloc(p->w * p->h);
+        } else if (strcmp(key, "board") == 0) {
+            if (p->cells == NULL) {
+                fail(file, lineno, "\"size\" must come before \"board\"");
+            }
+            row = 0;
+        } else if (strcmp(key, "p0") == 0 || strcmp(key, "p1") == 0) {
+            player_t* pl = &p->pl[key[1] - '0'];
+            pl->pos.x = atoi(a);
+            pl->pos.y = atoi(b);
+            pl->direction = parse_dir(c);
+            if (n != 4 || (int)pl->direction < 0) {
+                fail(file, lineno, "expected: p0|p1 <x> <y> <direction>");
+            }
+        } else if (strcmp(key, "tomove") == 0) {
+            p->tomove = (strcmp(a, "p1") == 0);
+        } else if (strcmp(key, "safe") == 0) {
+            for (char* s = a; *s; s++) {
+                int d = parse_dir(s);
+                if (d < 0) {
+                    fail(file, lineno, "invalid direction");
+                }
+                p->safe |= 1 << d;
+            }
+        } else if (strcmp(key, "best") == 0) {
+            p->best = parse_dir(a);
+        } else if (strcmp(key, "end") == 0) {
+            if (p->cells == NULL) {
+                fail(file, lineno, "position without board");
+            }
+            numPositions++;
+            p = NULL;
+        } else {
+            fail(file, lineno, "unknown keyword");
+        }
+    }
+    fclose(f);
+}
+
+
+/*
+ * Load the weights of the evaluation function from file "file".
+ */
+static void
+load_weights(const char* file) {
+    static char text[1024];
+    FILE* f = fopen(file, "r");
+    if (f == NULL) {
+        perror(file);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = fread(text, 1, sizeof(text), f);
+    fclose(f);
+    if (eval_load(text, size) != 0) {
+        fprintf(stderr, "%s: invalid weights\n", file);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+/*
+ * Load the rules of the computer player from file "file".
+ */
+static void
+load_rules(const char* file) {
+    static char text[4096];
+    FILE* f = fopen(file, "r");
+    if (f == NULL) {
+        perror(file);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = fread(text, 1, sizeof(text), f);
+    fclose(f);
+    if (rules_load(text, size) != 0) {
+        fprintf(stderr, "%s: invalid rules\n", file);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+/*
+ * Put position p onto the board. The border of the board is always wall.
+ */
+static void
+setup_position(position_t* p) {
+    board_init(p->w, p->h);
+    for (int y = 1; y < p->h - 1; y++) {
+        for (int x = 1; x < p->w - 1; x++) {
+            cell_t cell = CELL_EMPTY;
+            switch (p->cells[y * p->w + x]) {
+            case '#': cell = CELL_WALL; break;
+            case 'g': cell = CELL_P0; break;
+            case 'b': cell = CELL_P1; break;
+            }
+            put_board((coord_t){x, y}, cell);
+        }
+    }
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        p->pl[i].entity = i == 0 ? CELL_P0 : CELL_P1;
+        p->pl[i].name = i == 0 ? "GREEN" : "BLUE";
+        put_board(p->pl[i].pos, p->pl[i].entity);
+    }
+}
+
+
+/*
+ * Let the AI move "runs" times in every position; print a line per
+ * position (if "table") and a summary line starting with "label".
+ */
+static void
+run_positions(const char* label, int runs, uint64_t budget, int table) {
+    if (table) {
+        printf("%-24s %6s %6s %10s %10s %12s\n",
+                "position", "safe%", "best%", "time(us)", "nodes", "nodes/s");
+    }
+    double sumSafe = 0, sumBest = 0;
+    int numSafe = 0, numBest = 0;
+    uint64_t totalNodes = 0, totalTime = 0;
+    for (int i = 0; i < numPositions; i++) {
+        position_t* p = &positions[i];
+        int safe = 0;
+        int best = 0;
+        uint64_t nodes = 0;
+        uint64_t time = 0;
+        for (int r = 0; r < runs; r++) {
+            setup_position(p);
+            // positions are unrelated; nothing to learn from the last one,
+            // and nothing to pay for setting up this one
+            opp_model_newgame();
+            forget_computer_upkeep();
+            player_t me = p->pl[p->tomove];
+            player_t you = p->pl[1 - p->tomove];
+            me.rng = r + 1;
+            uint64_t start = get_current_time();
+            direction_t d = get_computer_move(start + budget * 1000, &me, &you);
+            time += get_current_time() - start;
+            nodes += get_computer_work(&me);
+            safe += (p->safe >> d) & 1;
+            best += (d == p->best);
+        }
+        totalNodes += nodes;
+        totalTime += time;
+        if (p->safe) {
+            sumSafe += 100.0 * safe / runs;
+            numSafe++;
+        }
+        if (p->best >= 0) {
+            sumBest += 100.0 * best / runs;
+            numBest++;
+        }
+        if (!table) {
+            continue;
+        }
+        printf("%-24s ", p->name);
+        if (p->safe) {
+            printf("%6.1f ", 100.0 * safe / runs);
+        } else {
+            printf("%6s ", "-");
+        }
+        if (p->best >= 0) {
+            printf("%6.1f ", 100.0 * best / runs);
+        } else {
+            printf("%6s ", "-");
+        }
+        printf("%10.2f %10.1f %12.0f\n", time / 1000.0 / runs,
+                (double)nodes / runs, time ? nodes * 1e9 / time : 0.0);
+    }
+    printf("%s: safe %.1f%%, best %.1f%%, %.2f us/move, %.0f nodes/s\n",
+            label,
+            numSafe ? sumSafe / numSafe : 0.0,
+            numBest ? sumBest / numBest : 0.0,
+            totalTime / 1000.0 / (numPositions * runs),
+            totalTime ? totalNodes * 1e9 / totalTime : 0.0);
+}
+
+
+int
+main(int argc, char** argv) {
+    int runs = 100;
+    uint64_t budget = 50000; // us
+    int opt;
+    while ((opt = getopt(argc, argv, "r:l:b:e:R:v")) != -1) {
+        switch (opt) {
+        case 'r': runs = atoi(optarg); break;
+        case 'l':
+            if (atoi(optarg) < 0 || atoi(optarg) >= AI_LEVELS) {
+                fprintf(stderr, "level must be 0 ... %d\n", AI_LEVELS - 1);
+                return EXIT_FAILURE;
+            }
+            set_computer_level(atoi(optarg));
+            break;
+        case 'b': budget = atoll(optarg); break;
+        case 'e': load_weights(optarg); break;
+        case 'R': load_rules(optarg); break;
+        case 'v': shim_loglevel = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-r runs] [-l level] [-b budget_us] "
+                    "[-e weights] [-R rules] [-v] file...\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    for (int i = optind; i < argc; i++) {
+        load_positions(argv[i]);
+    }
+    if (numPositions == 0 || runs < 1) {
+        fprintf(stderr, "nothing to do\n");
+        return EXIT_FAILURE;
+    }
+
+    // the AI sizes its buffers for the board it sees first
+    int maxX = 0;
+    int maxY = 0;
+    for (int i = 0; i < numPositions; i++) {
+        maxX = positions[i].w > maxX ? positions[i].w : maxX;
+        maxY = positions[i].h > maxY ? positions[i].h : maxY;
+    }
+    board_init(maxX, maxY);
+    init_computer_move();
+
+    printf("level: %s\n", get_computer_level_name(get_computer_level()));
+    char label[64];
+    snprintf(label, sizeof(label), "\n%d positions x %d runs", numPositions,
+            runs);
+    run_positions(label, runs, budget, 1);
+    uint64_t cycles;
+    unsigned long evals;
+    eval_get_stats(&cycles, &evals);
+    if (evals > 0) {
+        printf("evaluation: %lu positions, %.1f cycles/position\n",
+                evals, (double)cycles / evals);
+    }
+    if (eval_isloaded()) {
+        // what pruning with the evaluation function is worth
+        eval_set_weights(NULL);
+        run_positions("without evaluation", runs, budget, 0);
+    }
+    return EXIT_SUCCESS;
+}
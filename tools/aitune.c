@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Rule tuner: tunes the weights of the computer player's rules (see
+ * init_rules() in src/gameai.c), and optionally the cutoff and diff,
+ * by self-play, and writes the result in the format of rules_load(); put
+ * the file into the cpio archive as data/rules.txt (see Makefile).
+ * With -w, it tunes the weights of the evaluation function instead (see
+ * src/evaluate.c), starting from those loaded with -e, and writes them in
+ * the format of eval_load() (data/evalweights.txt).
+ *
+ * Usage: aitune [-i iterations] [-g games] [-v games] [-j jobs] [-l level]
+ *               [-s seed] [-c] [-d] [-w] [-e weights] [-o file]
+ *
+ * The tuner uses SPSA (simultaneous perturbation stochastic approximation):
+ * in every iteration, all parameters are changed at random by +c or -c at
+ * once (weights on a log scale), the two resulting parameter sets play
+ * "games" games against each other, and the parameters move towards the
+ * winner, by an amount proportional to the margin. The games of an
+ * iteration are spread over "jobs" worker processes (default: one per
+ * core). At the end, the tuned parameters play "-v" games against the
+ * built-in ones (with -w: the weights loaded with -e, and no evaluation
+ * function at all).
+ *
+ * A game starts with the players at their usual start positions, moved
+ * up or down at random, and both players decide on the same board in
+ * every tick (like the game does with CONFIG_APP_TRON_SMP_AI). The players
+ * swap sides every other game. A player that crashes loses; if both do,
+ * or the game takes too long, it is a draw.
+ *
+ * Options -c and -d also tune the cutoff and diff (the cutoff is used
+ * only by the levels that do not have their own); -l sets the difficulty
+ * level the games are played at (default: the game's default; see
+ * src/gameai.c), and -e loads the evaluation function, as the game does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "board_shim.h"
+#include "evaluate.h"
+#include "oppmodel.h"
+
+#define MAX_PARAMS 32
+#define MAX_JOBS 256
+
+/* board of the default game: 640x480 pixels, cell width 10 */
+#define BOARD_W 64
+#define BOARD_H 48
+
+/* a game longer than this (ticks) is a draw */
+#define MAX_TICKS (BOARD_W * BOARD_H)
+
+static int numParams;
+
+/* which parameters are tuned */
+static int tuned[MAX_PARAMS];
+
+/* tune the weights of the evaluation function rather than the rules */
+static int tuneWeights = 0;
+
+
+static uint32_t
+mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+
+/*
+ * Make "params" the parameters of the computer player: the rules (see
+ * get_computer_params()), or with -w the weights of the evaluation
+ * function; NULL turns the evaluation function off.
+ */
+static void
+set_params(const int* params) {
+    if (!tuneWeights) {
+        set_computer_params(params);
+        return;
+    }
+    int32_t w[EVAL_FEATURES];
+    for (int i = 0; i < EVAL_FEATURES && params != NULL; i++) {
+        w[i] = params[i];
+    }
+    eval_set_weights(params != NULL ? w : NULL);
+}
+
+
+/*
+ * Play one game; "a" and "b" are the parameters of the two players.
+ * @return: score of "a": 2 win, 1 draw, 0 loss
+ */
+static int
+play_game(const int* a, const int* b, uint32_t seed, int* ticks) {
+    player_t pl[NUMPLAYERS];
+    // a plays GREEN in even games, BLUE in odd ones
+    const int* params[NUMPLAYERS] = { seed & 1 ? b : a, seed & 1 ? a : b };
+    board_reset();
+    opp_model_newgame();
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        pl[i] = (player_t) {
+            .pos = { numCellsX * (3 - 2 * i) / 4,
+                     numCellsY / 4 + mix(seed + i) % (numCellsY / 2) },
+            .direction = North,
+            .entity = i == 0 ? CELL_P0 : CELL_P1,
+            .name = i == 0 ? "GREEN" : "BLUE",
+            .rng = mix(seed * 2 + i) | 1
+        };
+        put_board(pl[i].pos, pl[i].entity);
+    }
+    int crashed[NUMPLAYERS] = { 0 };
+    int t;
+    for (t = 0; t < MAX_TICKS && !crashed[0] && !crashed[1]; t++) {
+        direction_t dir[NUMPLAYERS];
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            set_params(params[i]);
+            dir[i] = get_computer_move(UINT64_MAX, &pl[i], &pl[1 - i]);
+        }
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            crashed[i] = move_apply(&pl[i], dir[i]);
+        }
+    }
+    *ticks += t;
+    int aIs = seed & 1;
+    if (crashed[aIs] == crashed[1 - aIs]) {
+        return 1;
+    }
+    return crashed[aIs] ? 0 : 2;
+}
+
+
+/*
+ * Play "games" games of parameters "a" against "b", spread over "jobs"
+ * processes.
+ * @return: share of points "a" got (0 ... 1)
+ */
+static double
+play_match(const int* a, const int* b, int games, int jobs, uint32_t seed,
+        long* ticks) {
+    int fds[MAX_JOBS];
+    for (int j = 0; j < jobs; j++) {
+        int p[2];
+        if (pipe(p) != 0) {
+            perror("pipe");
+            exit(EXIT_FAILURE);
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            close(p[0]);
+            int result[2] = { 0, 0 }; // points, ticks
+            for (int g = j; g < games; g += jobs) {
+                result[0] += play_game(a, b, mix(seed) + g, &result[1]);
+            }
+            if (write(p[1], result, sizeof(result)) != sizeof(result)) {
+                _exit(EXIT_FAILURE);
+            }
+            _exit(EXIT_SUCCESS);
+        }
+        close(p[1]);
+        fds[j] = p[0];
+    }
+    long points = 0;
+    for (int j = 0; j < jobs; j++) {
+        int result[2];
+        if (read(fds[j], result, sizeof(result)) != sizeof(result)) {
+            fprintf(stderr, "worker %d failed\n", j);
+            exit(EXIT_FAILURE);
+        }
+        close(fds[j]);
+        points += result[0];
+        *ticks += result[1];
+    }
+    while (wait(NULL) > 0) {
+        // reap the workers
+    }
+    return points / (2.0 * games);
+}
+
+
+/*
+ * Map point theta of the search space to parameters: weights and the
+ * cutoff are on a log (base 2) scale, diff in steps of 8 cells; the
+ * weights of the evaluation function in steps of EVAL_ONE / 8.
+ */
+static void
+to_params(const double* theta, int* params) {
+    if (tuneWeights) {
+        for (int i = 0; i < numParams; i++) {
+            double w = round(theta[i] * EVAL_ONE / 8);
+            params[i] = w < -16 * EVAL_ONE ? -16 * EVAL_ONE
+                      : w > 16 * EVAL_ONE ? 16 * EVAL_ONE : w;
+        }
+        return;
+    }
+    int numRules = numParams - 2;
+    for (int i = 0; i < numRules; i++) {
+        double w = round(pow(2, theta[i]));
+        params[i] = w < 1 ? 1 : w > 10000 ? 10000 : w;
+    }
+    double c = round(pow(2, theta[numRules]));
+    params[numRules] = c < 10 ? 10 : c > 1000 ? 1000 : c;
+    double d = round(theta[numRules + 1] * 8);
+    params[numRules + 1] = d < 0 ? 0 : d > 100 ? 100 : d;
+}
+
+
+static void
+from_params(const int* params, double* theta) {
+    if (tuneWeights) {
+        for (int i = 0; i < numParams; i++) {
+            theta[i] = params[i] * 8.0 / EVAL_ONE;
+        }
+        return;
+    }
+    int numRules = numParams - 2;
+    for (int i = 0; i < numRules; i++) {
+        theta[i] = log2(params[i]);
+    }
+    theta[numRules] = log2(params[numRules]);
+    theta[numRules + 1] = params[numRules + 1] / 8.0;
+}
+
+
+static void
+print_params(const char* label, const int* params) {
+    printf("%s", label);
+    for (int i = 0; i < numParams; i++) {
+        printf(" %d", params[i]);
+    }
+    printf("\n");
+}
+
+
+/*
+ * Load the weights of the evaluation function from file "file".
+ */
+static void
+load_weights(const char* file) {
+    static char text[1024];
+    FILE* f = fopen(file, "r");
+    if (f == NULL) {
+        perror(file);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = fread(text, 1, sizeof(text), f);
+    fclose(f);
+    if (eval_load(text, size) != 0) {
+        fprintf(stderr, "%s: invalid weights\n", file);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+int
+main(int argc, char** argv) {
+    int iterations = 50;
+    int games = 1000;
+    int verify = 4000;
+    int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int level = get_computer_level();
+    uint32_t seed = 1;
+    int tuneCutoff = 0;
+    int tuneDiff = 0;
+    const char* outFile = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:g:v:j:l:s:cdwe:o:")) != -1) {
+        switch (opt) {
+        case 'i': iterations = atoi(optarg); break;
+        case 'g': games = atoi(optarg); break;
+        case 'v': verify = atoi(optarg); break;
+        case 'j': jobs = atoi(optarg); break;
+        case 'l': level = atoi(optarg); break;
+        case 's': seed = atoi(optarg); break;
+        case 'c': tuneCutoff = 1; break;
+        case 'd': tuneDiff = 1; break;
+        case 'w': tuneWeights = 1; break;
+        case 'e': load_weights(optarg); break;
+        case 'o': outFile = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-i iterations] [-g games] [-v games] "
+                    "[-j jobs] [-l level] [-s seed] [-c] [-d] [-w] "
+                    "[-e weights] [-o file]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (games < 2 || jobs < 1 || jobs > MAX_JOBS
+    || level < 0 || level >= AI_LEVELS) {
+        fprintf(stderr, "invalid arguments\n");
+        return EXIT_FAILURE;
+    }
+
+    board_init(BOARD_W, BOARD_H);
+    init_computer_move();
+    set_computer_level(level);
+
+    int base[MAX_PARAMS];
+    if (tuneWeights) {
+        int32_t w[EVAL_FEATURES];
+        eval_get_weights(w);
+        numParams = EVAL_FEATURES;
+        for (int i = 0; i < numParams; i++) {
+            base[i] = w[i];
+            tuned[i] = 1;
+        }
+    } else {
+        numParams = get_computer_params(base, MAX_PARAMS);
+        for (int i = 0; i < numParams - 2; i++) {
+            tuned[i] = 1;
+        }
+        tuned[numParams - 2] = tuneCutoff;
+        tuned[numParams - 1] = tuneDiff;
+    }
+    printf("level %s, %d games per iteration, %d jobs\n",
+            get_computer_level_name(level), games, jobs);
+    print_params("start:", base);
+
+    // SPSA gains; see J. C. Spall, "Implementation of the simultaneous
+    // perturbation algorithm for stochastic optimization" (1998)
+    // (the evaluation weights are all on one linear scale, with small
+    // differences in score; they take larger steps)
+    const double a = tuneWeights ? 10.0 : 2.0;
+    const double c = 1.0;
+    const double bigA = iterations / 10.0;
+    double theta[MAX_PARAMS];
+    from_params(base, theta);
+
+    long totalTicks = 0;
+    long totalGames = 0;
+    uint64_t startTime = get_current_time();
+    for (int k = 0; k < iterations; k++) {
+        double ak = a / pow(k + 1 + bigA, 0.602);
+        double ck = c / pow(k + 1, 0.101);
+        double delta[MAX_PARAMS];
+        double plus[MAX_PARAMS];
+        double minus[MAX_PARAMS];
+        for (int i = 0; i < numParams; i++) {
+            delta[i] = tuned[i] ? (mix(seed * 7919 + k * 131 + i) & 1 ? 1 : -1)
+                                : 0;
+            plus[i] = theta[i] + ck * delta[i];
+            minus[i] = theta[i] - ck * delta[i];
+        }
+        int pp[MAX_PARAMS];
+        int pm[MAX_PARAMS];
+        to_params(plus, pp);
+        to_params(minus, pm);
+
+        uint64_t t0 = get_current_time();
+        long ticks = 0;
+        double score = play_match(pp, pm, games, jobs, seed * 1000003 + k,
+                &ticks);
+        double secs = (get_current_time() - t0) / 1e9;
+        totalTicks += ticks;
+        totalGames += games;
+
+        // f(plus) - f(minus) = 2 * score - 1
+        for (int i = 0; i < numParams; i++) {
+            if (tuned[i]) {
+                theta[i] += ak * (2 * score - 1) / (2 * ck * delta[i]);
+            }
+        }
+        int cur[MAX_PARAMS];
+        to_params(theta, cur);
+        printf("iteration %3d: plus scores %.3f; %.0f games/s, "
+                "%.0f ticks/game\n", k, score, games / secs,
+                (double)ticks / games);
+        print_params("  now:", cur);
+        fflush(stdout);
+    }
+    double secs = (get_current_time() - startTime) / 1e9;
+    if (iterations > 0) {
+        printf("tuning: %ld games in %.1f s (%.0f games/s, %.0f ticks/s)\n",
+                totalGames, secs, totalGames / secs, totalTicks / secs);
+    }
+
+    int best[MAX_PARAMS];
+    to_params(theta, best);
+    print_params("tuned:", best);
+    if (verify >= 2) {
+        long ticks = 0;
+        double score = play_match(best, base, verify, jobs, ~seed, &ticks);
+        printf("tuned vs. %s: %.3f +- %.3f (%d games)\n",
+                tuneWeights ? "start" : "built-in", score,
+                0.5 / sqrt(verify), verify);
+        if (tuneWeights) {
+            score = play_match(best, NULL, verify, jobs, ~seed, &ticks);
+            printf("tuned vs. no evaluation: %.3f +- %.3f (%d games)\n",
+                    score, 0.5 / sqrt(verify), verify);
+        }
+    }
+    if (outFile != NULL) {
+        char text[2048];
+        set_params(best);
+        int len = tuneWeights ? eval_save(text, sizeof(text))
+                              : rules_save(text, sizeof(text));
+        FILE* f = fopen(outFile, "w");
+        if (f == NULL) {
+            perror(outFile);
+            return EXIT_FAILURE;
+        }
+        if (tuneWeights) {
+            fprintf(f, "# Weights of the evaluation function (see "
+                    "src/evaluate.c), fixed point\n# with 8 fractional bits "
+                    "(256 = 1.0), written by tools/aitune -w,\n# in feature "
+                    "order:\n#   bias\n#   blocked: forward left right "
+                    "forward-left forward-right back-left\n#            "
+                    "back-right two-forward\n#   area distance head-on\n"
+                    "#   opponent quadrant: front-right front-left back-left "
+                    "back-right\n");
+        } else {
+            fprintf(f, "# Rules of the computer player (see src/gameai.c), "
+                    "written by tools/aitune\n");
+        }
+        fwrite(text, 1, len, f);
+        fclose(f);
+        printf("wrote %s\n", outFile);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Host (Linux) replacement for the parts of main.c the game AI depends on:
+ * memory allocation, time, and the log level. Together with src/board.c,
+ * this allows to link src/gameai.c into tools that run on the development
+ * machine.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "board_shim.h"
+
+int cellWidth = 10;
+int lineWidth = 6;
+
+int shim_loglevel = 0;
+
+void (*shim_poll)() = NULL;
+
+
+int
+get_loglevel() {
+    return shim_loglevel;
+}
+
+
+uint64_t
+get_current_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+int
+poll_during_search(uint64_t endTime) {
+    if (shim_poll != NULL) {
+        shim_poll();
+    }
+    return get_current_time() > endTime;
+}
+
+
+void*
+alloc_pages(size_t size) {
+    void* p = calloc(1, size);
+    if (p == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef BOARD_SHIM_H_
+#define BOARD_SHIM_H_
+
+#include "tron.h"
+
+/* log level returned by get_loglevel() */
+extern int shim_loglevel;
+
+/* if set, called by poll_during_search() (where the game reads the
+ * keyboard) */
+extern void (*shim_poll)();
+
+
+#endif /* BOARD_SHIM_H_ */
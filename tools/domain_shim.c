@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Host (Linux) replacement for the kernel objects src/aidomain.c uses,
+ * and for src/aiprocess.c: the process of the AI domain is a thread
+ * (pthreads), which shares all memory with the main thread, and an
+ * endpoint is a mailbox for one message. The message registers and the
+ * user data word are per thread, as they are in the IPC buffer.
+ *
+ * The capabilities of the process (AI_PROCESS_ENDPOINT, AI_PROCESS_REPLY)
+ * name the endpoints ai_process_start() was given, with the badge of a
+ * reply on the reply endpoint. The process never faults here.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <vka/object.h>
+#include "aiprocess.h"
+#include "domain_shim.h"
+
+/* number of message registers */
+#define NUM_MRS 8
+
+/* number of endpoints vka_alloc_endpoint() hands out */
+#define MAX_ENDPOINTS 4
+
+/* capabilities of the main thread: endpoint i is FIRST_ENDPOINT + i */
+#define FIRST_ENDPOINT 16
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    /* whether a message is waiting to be received */
+    int full;
+    seL4_MessageInfo_t info;
+    seL4_Word badge;
+    seL4_Word mrs[NUM_MRS];
+} endpoint_t;
+
+vka_t domainshim_vka;
+vspace_t domainshim_vspace;
+simple_t domainshim_simple;
+
+static endpoint_t endpoints[MAX_ENDPOINTS];
+static int numEndpoints = 0;
+
+/* the endpoints in the CSpace of the process */
+static seL4_CPtr processEndpoint;
+static seL4_CPtr processReply;
+static void (*processEntry)(void);
+static pthread_t processThread;
+
+/* per thread */
+static __thread int inProcess = 0;
+static __thread seL4_Word userData = 0;
+static __thread seL4_Word mrs[NUM_MRS];
+
+
+int
+vka_alloc_endpoint(vka_t* vka, vka_object_t* result) {
+    assert(numEndpoints < MAX_ENDPOINTS);
+    endpoint_t* ep = &endpoints[numEndpoints];
+    pthread_mutex_init(&ep->lock, NULL);
+    pthread_cond_init(&ep->changed, NULL);
+    ep->full = 0;
+    result->cptr = FIRST_ENDPOINT + numEndpoints++;
+    return 0;
+}
+
+
+/*
+ * Look capability "cap" of the calling thread up.
+ * @param badge: returns the badge of the capability
+ */
+static endpoint_t*
+lookup(seL4_CPtr cap, seL4_Word* badge) {
+    *badge = 0;
+    if (inProcess) {
+        assert(cap == AI_PROCESS_ENDPOINT || cap == AI_PROCESS_REPLY);
+        if (cap == AI_PROCESS_REPLY) {
+            *badge = AI_PROCESS_REPLY_BADGE;
+        }
+        cap = cap == AI_PROCESS_ENDPOINT ? processEndpoint : processReply;
+    }
+    assert(FIRST_ENDPOINT <= cap && cap < FIRST_ENDPOINT + numEndpoints);
+    return &endpoints[cap - FIRST_ENDPOINT];
+}
+
+
+seL4_MessageInfo_t
+seL4_MessageInfo_new(seL4_Word label, seL4_Word capsUnwrapped,
+        seL4_Word extraCaps, seL4_Word length) {
+    assert(length <= NUM_MRS);
+    return (seL4_MessageInfo_t){ .label = label, .length = length };
+}
+
+
+seL4_Word
+seL4_MessageInfo_get_label(seL4_MessageInfo_t info) {
+    return info.label;
+}
+
+
+void
+seL4_Send(seL4_CPtr dest, seL4_MessageInfo_t info) {
+    seL4_Word badge;
+    endpoint_t* ep = lookup(dest, &badge);
+    pthread_mutex_lock(&ep->lock);
+    while (ep->full) {
+        pthread_cond_wait(&ep->changed, &ep->lock);
+    }
+    ep->full = 1;
+    ep->info = info;
+    ep->badge = badge;
+    memcpy(ep->mrs, mrs, info.length * sizeof(seL4_Word));
+    pthread_cond_broadcast(&ep->changed);
+    pthread_mutex_unlock(&ep->lock);
+}
+
+
+seL4_MessageInfo_t
+seL4_Wait(seL4_CPtr src, seL4_Word* sender) {
+    seL4_Word badge;
+    endpoint_t* ep = lookup(src, &badge);
+    pthread_mutex_lock(&ep->lock);
+    while (!ep->full) {
+        pthread_cond_wait(&ep->changed, &ep->lock);
+    }
+    ep->full = 0;
+    const seL4_MessageInfo_t info = ep->info;
+    memcpy(mrs, ep->mrs, info.length * sizeof(seL4_Word));
+    if (sender != NULL) {
+        *sender = ep->badge;
+    }
+    pthread_cond_broadcast(&ep->changed);
+    pthread_mutex_unlock(&ep->lock);
+    return info;
+}
+
+
+void
+seL4_SetMR(int i, seL4_Word mr) {
+    assert(0 <= i && i < NUM_MRS);
+    mrs[i] = mr;
+}
+
+
+seL4_Word
+seL4_GetMR(int i) {
+    assert(0 <= i && i < NUM_MRS);
+    return mrs[i];
+}
+
+
+void
+seL4_SetUserData(seL4_Word data) {
+    userData = data;
+}
+
+
+seL4_Word
+seL4_GetUserData() {
+    return userData;
+}
+
+
+void
+ai_process_create(vka_t* vka, vspace_t* vspace, simple_t* simple) {
+}
+
+
+void
+ai_process_map(void* vaddr, size_t numPages) {
+}
+
+
+const void*
+ai_process_share(const void* vaddr, size_t size) {
+    return vaddr;
+}
+
+
+static void*
+run_process(void* arg) {
+    inProcess = 1;
+    processEntry();
+    return NULL;
+}
+
+
+void
+ai_process_start(void (*entry)(void), seL4_CPtr endpoint,
+        seL4_CPtr replyEndpoint) {
+    processEndpoint = endpoint;
+    processReply = replyEndpoint;
+    processEntry = entry;
+    if (pthread_create(&processThread, NULL, run_process, NULL) != 0) {
+        fprintf(stderr, "cannot start the AI domain\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+void
+ai_process_stop() {
+    // the process does not fault on the host
+    assert(0);
+}
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef DOMAIN_SHIM_H_
+#define DOMAIN_SHIM_H_
+
+#include <vka/vka.h>
+#include <vspace/vspace.h>
+#include <simple/simple.h>
+
+/* "system" to hand to ai_domain_init() */
+extern vka_t domainshim_vka;
+extern vspace_t domainshim_vspace;
+extern simple_t domainshim_simple;
+
+
+#endif /* DOMAIN_SHIM_H_ */
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * AI domain check: plays rounds on the board of the default game twice,
+ * once with the computer players of the main thread (get_computer_move())
+ * and once through the AI domain (src/aidomain.c; its process is a thread
+ * here, see domain_shim.c), and checks that every computer move, and the
+ * work it took, is the same both times.
+ *
+ * Usage: domaincheck [-n rounds] [-s seed] [-e weights]
+ *
+ * The rounds are played one after the other, as in the game, at every
+ * level but "timed" (whose moves depend on the speed of the machine), so
+ * that whatever the AI domain carries over from one round to the next
+ * shows. They take turns in who plays:
+ *
+ *   - two computer players;
+ *   - a computer player against a random walker (like a human player:
+ *     its moves are only logged, not requested);
+ *   - two random walkers for the first WALK_TICKS ticks, then two
+ *     computer players (many cells for the AI domain to catch up on).
+ *
+ * Last, two computer players play a round at level "timed" through the
+ * AI domain, with TIMED_NS per move, to check that the main thread
+ * drains the keyboard while it waits (see ai_domain_poll()).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "aidomain.h"
+#include "board.h"
+#include "board_shim.h"
+#include "domain_shim.h"
+#include "evaluate.h"
+
+/* board of the default game: 640x480 pixels, cell width 10 */
+#define BOARD_W 64
+#define BOARD_H 48
+
+/* a round longer than this (ticks) is given up */
+#define MAX_TICKS (BOARD_W * BOARD_H)
+
+/* ticks the random walkers play in the third kind of round */
+#define WALK_TICKS 160
+
+/* time per move at level "timed" (ns) */
+#define TIMED_NS 5000000
+
+/* who plays a round (see above) */
+enum { ROUND_COMPUTERS, ROUND_WALKER, ROUND_WALKERS_FIRST, ROUND_KINDS };
+
+static const direction_t back[] = { East, South, West, North };
+
+/* a computer move */
+typedef struct {
+    direction_t dir;
+    unsigned long work;
+} move_t;
+
+static move_t moves[MAX_TICKS * NUMPLAYERS];
+static int numMoves;
+
+/* rounds of the third kind, and those in which the random walkers lasted
+ * all of WALK_TICKS ticks */
+static int walkRounds = 0;
+static int walkedThrough = 0;
+
+/* number of times the main thread drained the "keyboard" */
+static int drained = 0;
+
+
+static uint32_t
+mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+
+static coord_t
+step(coord_t pos, direction_t dir) {
+    static const coord_t delta[] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+    return (coord_t){pos.x + delta[dir].x, pos.y + delta[dir].y};
+}
+
+
+/*
+ * Move of a random walker "p": mostly straight on; else, or if it cannot
+ * go straight on, into the largest region of empty cells it can move to.
+ */
+static direction_t
+walk(const player_t* p, uint32_t* rng) {
+    *rng = mix(*rng);
+    direction_t dir = p->direction;
+    if (*rng % 16 != 0 && isempty_cell(step(p->pos, dir))) {
+        return dir;
+    }
+    int largest = -1;
+    for (direction_t d = West; d < DirLength; d++) {
+        coord_t pos = step(p->pos, d);
+        if (d != back[p->direction] && isempty_cell(pos)
+        && region_size(pos) > largest) {
+            largest = region_size(pos);
+            dir = d;
+        }
+    }
+    return dir;
+}
+
+
+/*
+ * Stands in for the game's poll_during_search() (see src/main.c).
+ */
+static void
+poll() {
+    if (seL4_GetUserData() == AI_DOMAIN_GAME) {
+        ai_domain_poll();
+    } else {
+        drained++;
+    }
+}
+
+
+/*
+ * Play a round of kind "kind" from seed "s", as run_game() in src/main.c
+ * does, with the computer players of the main thread or (if "domain") of
+ * the AI domain.
+ * @return: 0 if all computer moves are those in "moves" (unless
+ *          "record", which puts them there), else the number of the first
+ *          move that is not
+ */
+static int
+play_round(int kind, uint32_t s, int domain, int record) {
+    const int timed = is_computer_level_timed(get_computer_level());
+    player_t pl[NUMPLAYERS];
+    uint32_t rng = mix(s);
+    board_reset();
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        pl[i] = (player_t) {
+            .pos = { numCellsX * (3 - 2 * i) / 4, numCellsY / 2 },
+            .direction = North,
+            .entity = i == 0 ? CELL_P0 : CELL_P1,
+            .name = i == 0 ? "GREEN" : "BLUE",
+            .rng = mix(s * 2 + i) | 1
+        };
+        put_board(pl[i].pos, pl[i].entity);
+    }
+    ai_domain_newround(pl);
+    init_computer_move();
+
+    int n = 0;
+    for (int t = 0; t < MAX_TICKS; t++) {
+        if (kind == ROUND_WALKERS_FIRST && record && t == WALK_TICKS) {
+            walkedThrough++;
+        }
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            player_t* me = &pl[i];
+            player_t* you = &pl[1 - i];
+            direction_t dir;
+            if (kind == ROUND_COMPUTERS || (kind == ROUND_WALKER && i == 0)
+            || (kind == ROUND_WALKERS_FIRST && t >= WALK_TICKS)) {
+                move_t m;
+                if (domain) {
+                    m.dir = ai_domain_move(timed ? get_current_time()
+                            + TIMED_NS : UINT64_MAX, me, you);
+                    m.work = ai_domain_work(me);
+                } else {
+                    m.dir = get_computer_move(UINT64_MAX, me, you);
+                    m.work = get_computer_work(me);
+                }
+                if (record) {
+                    moves[n] = m;
+                } else if (timed) {
+                    // the moves depend on the time
+                } else if (n >= numMoves || moves[n].dir != m.dir
+                || moves[n].work != m.work) {
+                    return n + 1;
+                }
+                n++;
+                dir = m.dir;
+            } else {
+                dir = walk(me, &rng);
+            }
+            if (move_apply(me, dir)) {
+                if (record) {
+                    numMoves = n;
+                }
+                return !record && !timed && n != numMoves ? n + 1 : 0;
+            }
+            ai_domain_moved(me);
+        }
+    }
+    if (record) {
+        numMoves = n;
+    }
+    return !record && !timed && n != numMoves ? n + 1 : 0;
+}
+
+
+/*
+ * Load the weights of the evaluation function from file "file".
+ */
+static void
+load_weights(const char* file) {
+    static char text[1024];
+    FILE* f = fopen(file, "r");
+    if (f == NULL) {
+        perror(file);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = fread(text, 1, sizeof(text), f);
+    fclose(f);
+    if (eval_load(text, size) != 0) {
+        fprintf(stderr, "%s: invalid weights\n", file);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+int
+main(int argc, char** argv) {
+    int rounds = 3 * ROUND_KINDS;
+    uint32_t seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:e:")) != -1) {
+        switch (opt) {
+        case 'n': rounds = atoi(optarg); break;
+        case 's': seed = atoi(optarg); break;
+        case 'e': load_weights(optarg); break;
+        default:
+            rounds = 0;
+            break;
+        }
+    }
+    if (rounds < 1) {
+        fprintf(stderr, "usage: %s [-n rounds] [-s seed] [-e weights]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    board_init(BOARD_W, BOARD_H);
+    init_computer_move();
+    ai_domain_init(&domainshim_vka, &domainshim_vspace, &domainshim_simple);
+    shim_poll = poll;
+
+    int failed = 0;
+    for (int level = 0; level < AI_LEVELS; level++) {
+        if (is_computer_level_timed(level)) {
+            continue;
+        }
+        set_computer_level(level);
+        unsigned long total = 0;
+        for (int r = 0; r < rounds; r++) {
+            const uint32_t s = mix(seed + r);
+            play_round(r % ROUND_KINDS, s, 0, 1);
+            walkRounds += r % ROUND_KINDS == ROUND_WALKERS_FIRST;
+            const int bad = play_round(r % ROUND_KINDS, s, 1, 0);
+            if (bad != 0) {
+                printf("level %s, round %d: computer move %d differs in "
+                        "the AI domain\n", get_computer_level_name(level), r,
+                        bad);
+                failed = 1;
+            }
+            total += numMoves;
+        }
+        printf("level %s: %d rounds, %lu computer moves\n",
+                get_computer_level_name(level), rounds, total);
+    }
+    printf("random walkers: %d of %d rounds reached tick %d\n",
+            walkedThrough, walkRounds, WALK_TICKS);
+
+    for (int level = 0; level < AI_LEVELS; level++) {
+        if (!is_computer_level_timed(level)) {
+            continue;
+        }
+        set_computer_level(level);
+        drained = 0;
+        play_round(ROUND_COMPUTERS, mix(seed), 1, 0);
+        printf("level %s: the main thread drained the keyboard %d times "
+                "while the AI domain searched\n",
+                get_computer_level_name(level), drained);
+        if (drained == 0) {
+            failed = 1;
+        }
+    }
+    if (failed) {
+        printf("FAILED: the AI domain does not play like the main thread, "
+                "or keeps the keyboard from being read\n");
+        return EXIT_FAILURE;
+    }
+    printf("the AI domain plays like the main thread\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Host (Linux) replacement for the hardware src/graphics.c draws on: a
+ * VBE mode (32 bits per pixel) with its linear frame buffer in normal
+ * memory, the Bochs VBE registers used for page flipping, and the cpio
+ * archive, which is read from directories of the source tree instead.
+ * Together with the stand-in headers in tools/host, this allows to link
+ * src/graphics.c into tools that run on the development machine.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sel4/sel4.h>
+#include <cpio/cpio.h>
+#include "tron.h"
+#include "fb_shim.h"
+
+ps_io_mapper_t fbshim_io_mapper;
+ps_io_port_ops_t fbshim_port_ops;
+vspace_t fbshim_vspace;
+
+/* graphics.c refers to the archive linked into the image */
+char _cpio_archive[1];
+
+static seL4_IA32_BootInfo bootinfo;
+
+/* the frame buffer (all pages), once graphics.c has mapped it */
+static uint32_t* vram = NULL;
+static size_t vramSize = 0;
+
+/* number of pages of video memory */
+static int numPages;
+
+/* Bochs VBE registers: selected register, and display start line */
+static uint16_t dispiIndex;
+static uint16_t dispiYOffset;
+
+/* ':' separated list of directories cpio_get_file() looks in */
+static const char* assets;
+
+/* files read by cpio_get_file(); graphics.c expects them to stay around */
+#define MAX_FILES 16
+static struct {
+    char name[64];
+    char* data;
+    unsigned long size;
+} files[MAX_FILES];
+static int numFiles = 0;
+
+
+/*
+ * Set up a VBE mode of xres x yres pixels with "pages" screens of video
+ * memory (more than one enables page flipping), and where to find the
+ * files of the cpio archive.
+ * @return: the boot information to pass to gfx_init_IA32BootInfo()
+ */
+seL4_IA32_BootInfo*
+fbshim_init(int xres, int yres, int pages, const char* assetPath) {
+    seL4_VBEModeInfoBlock* mib = &bootinfo.vbeModeInfoBlock;
+    memset(&bootinfo, 0, sizeof(bootinfo));
+    memcpy(bootinfo.vbeInfoBlock.signature, "VESA", 4);
+    bootinfo.vbeInfoBlock.version = 0x300;
+    bootinfo.vbeMode = 0x4118;
+    mib->xRes = xres;
+    mib->yRes = yres;
+    mib->bitsPerPixel = 32;
+    mib->memoryModel = 6; // direct color
+    mib->bytesPerScanLine = xres * 4;
+    mib->linBytesPerScanLine = xres * 4;
+    mib->imagePages = mib->linImagePages = pages - 1;
+    mib->redLen = mib->greenLen = mib->blueLen = 8;
+    mib->linRedLen = mib->linGreenLen = mib->linBlueLen = 8;
+    mib->redOff = mib->linRedOff = 16;
+    mib->greenOff = mib->linGreenOff = 8;
+    mib->blueOff = mib->linBlueOff = 0;
+    mib->physBasePtr = 0xfd000000;
+    numPages = pages;
+    assets = assetPath;
+    dispiYOffset = 0;
+    return &bootinfo;
+}
+
+
+void*
+ps_io_map(ps_io_mapper_t* io_mapper, uintptr_t paddr, size_t size,
+        int cached, ps_mem_flags_t flags) {
+    free(vram);
+    vram = alloc_pages(size);
+    vramSize = size;
+    return vram;
+}
+
+
+int
+ps_io_port_in(const ps_io_port_ops_t* port_ops, uint32_t port,
+        int io_size, uint32_t* result) {
+    const seL4_VBEModeInfoBlock* mib = &bootinfo.vbeModeInfoBlock;
+    *result = 0xffffffff;
+    if (port == 0x3da) {
+        // the vertical retrace (bit 3) begins and ends with every read
+        static uint32_t status = 0;
+        status ^= 0x08;
+        *result = status;
+    } else if (port == 0x1cf) {
+        switch (dispiIndex) {
+        case 0x0: *result = numPages > 1 ? 0xb0c5 : 0xffff; break;
+        case 0x7: *result = numPages * mib->yRes; break;
+        case 0x9: *result = dispiYOffset; break;
+        }
+    }
+    return 0;
+}
+
+
+int
+ps_io_port_out(const ps_io_port_ops_t* port_ops, uint32_t port,
+        int io_size, uint32_t val) {
+    if (port == 0x1ce) {
+        dispiIndex = val;
+    } else if (port == 0x1cf && dispiIndex == 0x9) {
+        dispiYOffset = val;
+    }
+    return 0;
+}
+
+
+int
+seL4_IA32_Page_Remap(seL4_CPtr service, seL4_CPtr pd,
+        seL4_CapRights rights, seL4_IA32_VMAttributes attr) {
+    // host memory has one type only
+    return 0;
+}
+
+
+seL4_CPtr
+vspace_get_cap(vspace_t* vspace, void* vaddr) {
+    // one "large page" covers all of video memory
+    return 1;
+}
+
+
+void*
+cpio_get_file(void* archive, const char* name, unsigned long* size) {
+    for (int i = 0; i < numFiles; i++) {
+        if (strcmp(files[i].name, name) == 0) {
+            *size = files[i].size;
+            return files[i].data;
+        }
+    }
+    if (numFiles == MAX_FILES || strlen(name) >= sizeof(files[0].name)) {
+        return NULL;
+    }
+
+    // try each directory of the asset path
+    const char* dir = assets;
+    while (dir != NULL && *dir != '\0') {
+        const char* end = strchr(dir, ':');
+        int len = end ? end - dir : (int)strlen(dir);
+        char path[512];
+        snprintf(path, sizeof(path), "%.*s/%s", len, dir, name);
+        FILE* f = fopen(path, "rb");
+        if (f != NULL) {
+            fseek(f, 0, SEEK_END);
+            long n = ftell(f);
+            fseek(f, 0, SEEK_SET);
+            // zero terminated, for the sscanf() on PPM headers
+            char* data = alloc_pages(n + 1);
+            if (fread(data, 1, n, f) != (size_t)n) {
+                n = 0;
+            }
+            fclose(f);
+            strcpy(files[numFiles].name, name);
+            files[numFiles].data = data;
+            files[numFiles].size = n;
+            numFiles++;
+            *size = n;
+            return data;
+        }
+        dir = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+
+/*
+ * The pixels currently on screen: the page the display starts at.
+ */
+const uint32_t*
+fbshim_screen() {
+    const seL4_VBEModeInfoBlock* mib = &bootinfo.vbeModeInfoBlock;
+    return vram + dispiYOffset * (mib->linBytesPerScanLine / 4);
+}
+
+
+/*
+ * FNV-1a hash of the pixels on screen (visible width only).
+ */
+uint32_t
+fbshim_hash() {
+    const seL4_VBEModeInfoBlock* mib = &bootinfo.vbeModeInfoBlock;
+    const uint32_t* screen = fbshim_screen();
+    uint32_t h = 2166136261u;
+    for (int y = 0; y < mib->yRes; y++) {
+        const uint32_t* row = screen + y * (mib->linBytesPerScanLine / 4);
+        for (int x = 0; x < mib->xRes; x++) {
+            for (int b = 0; b < 32; b += 8) {
+                h = (h ^ ((row[x] >> b) & 0xff)) * 16777619u;
+            }
+        }
+    }
+    return h;
+}
+
+
+/*
+ * Write the pixels on screen to a PPM file.
+ * @return: 0 on success
+ */
+int
+fbshim_dump(const char* filename) {
+    const seL4_VBEModeInfoBlock* mib = &bootinfo.vbeModeInfoBlock;
+    const uint32_t* screen = fbshim_screen();
+    FILE* f = fopen(filename, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", mib->xRes, mib->yRes);
+    for (int y = 0; y < mib->yRes; y++) {
+        const uint32_t* row = screen + y * (mib->linBytesPerScanLine / 4);
+        for (int x = 0; x < mib->xRes; x++) {
+            fputc(row[x] >> mib->linRedOff, f);
+            fputc(row[x] >> mib->linGreenOff, f);
+            fputc(row[x] >> mib->linBlueOff, f);
+        }
+    }
+    return fclose(f);
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+#ifndef FB_SHIM_H_
+#define FB_SHIM_H_
+
+#include <stdint.h>
+#include <sel4/arch/bootinfo.h>
+#include <sel4platsupport/io.h>
+#include <vspace/vspace.h>
+#include <cpio/cpio.h>
+
+/* "devices" to hand to src/graphics.c */
+extern ps_io_mapper_t fbshim_io_mapper;
+extern ps_io_port_ops_t fbshim_port_ops;
+extern vspace_t fbshim_vspace;
+
+/* stands in for the cpio archive; see cpio_get_file() */
+extern char _cpio_archive[];
+
+seL4_IA32_BootInfo* fbshim_init(int xres, int yres, int pages,
+        const char* assetPath);
+const uint32_t* fbshim_screen();
+uint32_t fbshim_hash();
+int fbshim_dump(const char* filename);
+
+
+#endif /* FB_SHIM_H_ */
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Renderer check: runs src/graphics.c on the host, against the in-memory
+ * frame buffer of fb_shim.c, draws a fixed sequence of scenes the way the
+ * game does, and checks what ends up on screen:
+ *
+ *  - images from images/ must appear pixel for pixel where they are drawn
+ *    opaque (the PPM files are read independently of graphics.c);
+ *  - the hash of each scene must match the one in the golden file, which
+ *    "-u" (re)writes for the current screen size.
+ *
+ * Usage: gfxcheck [-s WxH] [-f] [-g golden] [-u] [-d dir] [-b]
+ *
+ *   -s  screen size (default 640x480)
+ *   -f  page flipping (two pages of video memory); the screen has to look
+ *       the same as without
+ *   -g  golden file (default golden.txt)
+ *   -u  update the golden file instead of checking against it
+ *   -d  write every scene to dir/<scene>.ppm
+ *   -b  also run the benchmarks of the drawing functions (src/gfxbench.c)
+ *
+ * The exit status is 0 if all checks passed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tron.h"
+#include "board.h"
+#include "graphics.h"
+#include "gfxbench.h"
+#include "board_shim.h"
+#include "fb_shim.h"
+
+/* directories with the files of the cpio archive */
+#define ASSETS "../images:../data"
+
+static int xres = 640;
+static int yres = 480;
+static int failures = 0;
+
+/* golden file: one "<W>x<H> <scene> <hash>" line per scene and size */
+#define MAX_GOLDEN 64
+static struct {
+    char size[16];
+    char scene[32];
+    uint32_t hash;
+} golden[MAX_GOLDEN];
+static int numGolden = 0;
+
+
+static void
+load_golden(const char* file) {
+    FILE* f = fopen(file, "r");
+    if (f == NULL) {
+        return;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), f) && numGolden < MAX_GOLDEN) {
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%15s %31s %x", golden[numGolden].size,
+                golden[numGolden].scene, &golden[numGolden].hash) == 3) {
+            numGolden++;
+        }
+    }
+    fclose(f);
+}
+
+
+static void
+save_golden(const char* file) {
+    FILE* f = fopen(file, "w");
+    if (f == NULL) {
+        perror(file);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(f, "# screen hashes of the scenes of gfxcheck; "
+            "regenerate with gfxcheck -u\n");
+    for (int i = 0; i < numGolden; i++) {
+        fprintf(f, "%s %s 0x%08x\n", golden[i].size, golden[i].scene,
+                golden[i].hash);
+    }
+    fclose(f);
+}
+
+
+/*
+ * Find the golden entry for scene at the current size; add one if there
+ * is none (and add is set).
+ */
+static int
+find_golden(const char* scene, int add) {
+    char size[16];
+    snprintf(size, sizeof(size), "%dx%d", xres, yres);
+    for (int i = 0; i < numGolden; i++) {
+        if (strcmp(golden[i].size, size) == 0
+        && strcmp(golden[i].scene, scene) == 0) {
+            return i;
+        }
+    }
+    if (!add || numGolden == MAX_GOLDEN) {
+        return -1;
+    }
+    strcpy(golden[numGolden].size, size);
+    strcpy(golden[numGolden].scene, scene);
+    return numGolden++;
+}
+
+
+/*
+ * Check that image "name" is on screen at (x, y), pixel for pixel.
+ */
+static void
+check_asset(const char* name, int x0, int y0) {
+    unsigned long size;
+    char* img = cpio_get_file(_cpio_archive, name, &size);
+    int w = 0;
+    int h = 0;
+    char* src = img ? strstr(img, "\n255\n") : NULL;
+    if (src == NULL || sscanf(img, "P6\n%d %d\n255\n", &w, &h) != 2) {
+        printf("  %s: cannot read image\n", name);
+        failures++;
+        return;
+    }
+    const uint8_t* p = (const uint8_t*)src + 5;
+    const uint32_t* screen = fbshim_screen();
+    int bad = 0;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++, p += 3) {
+            uint32_t want = (p[0] << 16) | (p[1] << 8) | p[2];
+            if ((screen[(y0 + y) * xres + x0 + x] & 0xffffff) != want) {
+                bad++;
+            }
+        }
+    }
+    if (bad) {
+        printf("  %s: %d of %d pixels differ\n", name, bad, w * h);
+        failures++;
+    }
+}
+
+
+/*
+ * Check (or with update, record) the hash of the screen after a scene.
+ */
+static void
+check_scene(const char* scene, int update, const char* dumpDir) {
+    uint32_t h = fbshim_hash();
+    if (dumpDir != NULL) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s.ppm", dumpDir, scene);
+        if (fbshim_dump(path) != 0) {
+            perror(path);
+        }
+    }
+    int i = find_golden(scene, update);
+    if (update) {
+        golden[i].hash = h;
+        printf("%-12s 0x%08x\n", scene, h);
+    } else if (i < 0) {
+        printf("%-12s 0x%08x no golden hash\n", scene, h);
+        failures++;
+    } else if (golden[i].hash != h) {
+        printf("%-12s 0x%08x MISMATCH (golden 0x%08x)\n", scene, h,
+                golden[i].hash);
+        failures++;
+    } else {
+        printf("%-12s 0x%08x ok\n", scene, h);
+    }
+}
+
+
+/*
+ * Draw the move of player p the way update_world() in main.c does.
+ */
+static void
+draw_move(const player_t* p, uint32_t color) {
+    const int offset = (cellWidth - lineWidth) / 2;
+    static const coord_t start[] = { {0,0}, {0,0}, {-1,0}, {0,-1}};
+    const coord_t wh[] = {
+            {cellWidth + lineWidth, lineWidth},
+            {lineWidth, cellWidth + lineWidth},
+            {cellWidth + lineWidth, lineWidth},
+            {lineWidth, cellWidth + lineWidth}
+    };
+    int lx = (p->pos.x + start[p->direction].x) * cellWidth + offset;
+    int ly = (p->pos.y + start[p->direction].y) * cellWidth + offset;
+    gfx_draw_rect(lx, ly, wh[p->direction].x, wh[p->direction].y, color);
+}
+
+
+/*
+ * Play a scripted round (a fixed random walk for both players, which
+ * does not depend on the AI) on the board and on screen, presenting
+ * every tick like run_game() does.
+ */
+static void
+play_round(uint32_t* background) {
+    uint32_t colors[] = {0, gfx_map_color(0, 200, 0),
+            gfx_map_color(0, 0, 200), gfx_map_color(200, 0, 0)};
+    player_t pl[NUMPLAYERS] = {
+            {.entity = CELL_P0, .direction = North,
+             .pos = {numCellsX * 3 / 4, numCellsY / 2}},
+            {.entity = CELL_P1, .direction = North,
+             .pos = {numCellsX * 1 / 4, numCellsY / 2}}};
+
+    board_reset();
+    gfx_restore_rect(0, 0, XRES, YRES, background);
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        put_board(pl[i].pos, pl[i].entity);
+    }
+
+    uint32_t rng = 12345;
+    int stuck = 0;
+    for (int step = 0; step < 400 && !stuck; step++) {
+        for (int i = 0; i < NUMPLAYERS && !stuck; i++) {
+            // go straight, or (1 in 8) turn; never into a wall
+            direction_t dirs[DirLength];
+            int n = 0;
+            for (direction_t d = West; d < DirLength; d++) {
+                static const coord_t delta[] = {{-1,0}, {0,-1}, {1,0}, {0,1}};
+                coord_t next = {pl[i].pos.x + delta[d].x,
+                                pl[i].pos.y + delta[d].y};
+                if (isempty_cell(next)) {
+                    dirs[n++] = d;
+                }
+            }
+            if (n == 0) {
+                stuck = 1;
+                break;
+            }
+            rng = rng * 1103515245 + 12345;
+            direction_t d = dirs[(rng >> 16) % n];
+            for (int k = 0; k < n; k++) {
+                if (dirs[k] == pl[i].direction && (rng >> 8) % 8 != 0) {
+                    d = pl[i].direction;
+                }
+            }
+            move_apply(&pl[i], d);
+            draw_move(&pl[i], colors[pl[i].entity]);
+        }
+        gfx_present();
+    }
+}
+
+
+int
+main(int argc, char** argv) {
+    int pages = 1;
+    int update = 0;
+    int bench = 0;
+    const char* goldenFile = "golden.txt";
+    const char* dumpDir = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:fg:ud:b")) != -1) {
+        switch (opt) {
+        case 's':
+            if (sscanf(optarg, "%dx%d", &xres, &yres) != 2
+            || xres < MIN_XRES || yres < MIN_YRES) {
+                fprintf(stderr, "bad size %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'f': pages = 2; break;
+        case 'g': goldenFile = optarg; break;
+        case 'u': update = 1; break;
+        case 'd': dumpDir = optarg; break;
+        case 'b': bench = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-s WxH] [-f] [-g golden] [-u] "
+                    "[-d dir] [-b]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    load_golden(goldenFile);
+
+    seL4_IA32_BootInfo* bootinfo = fbshim_init(xres, yres, pages, ASSETS);
+    gfx_init_IA32BootInfo(bootinfo);
+    gfx_init_page_flip(&fbshim_port_ops);
+    gfx_map_video_ram(&fbshim_io_mapper);
+    gfx_tune_video_ram(&fbshim_vspace, 0);
+    board_init(xres / cellWidth, yres / cellWidth);
+    printf("screen %dx%d, %d page(s); board %dx%d cells\n",
+            xres, yres, pages, numCellsX, numCellsY);
+
+    gfx_display_testpic();
+    gfx_present();
+    check_scene("testpic", update, dumpDir);
+
+    gfx_diplay_ppm(0, 0, "sel4.ppm", 1);
+    gfx_present();
+    check_asset("sel4.ppm", 0, 0);
+    check_scene("splash", update, dumpDir);
+
+    // as show_startscreen() in main.c
+    gfx_fill_screen(0);
+    gfx_diplay_ppm((xres - 200) / 2, 30, "title.ppm", 1);
+    gfx_diplay_ppm((xres - 160) / 2, 150, "menu.ppm", 1);
+    gfx_present();
+    check_asset("title.ppm", (xres - 200) / 2, 30);
+    check_asset("menu.ppm", (xres - 160) / 2, 150);
+    check_scene("startscreen", update, dumpDir);
+
+    // as draw_empty_board() in main.c
+    uint32_t* background = alloc_pages(XRES * YRES * sizeof(uint32_t));
+    gfx_draw_rect(0, 0, XRES, YRES, gfx_map_color(200, 0, 0));
+    gfx_draw_rect(cellWidth, cellWidth, XRES - 2 * cellWidth,
+            YRES - 2 * cellWidth, 0);
+    gfx_save_rect(0, 0, XRES, YRES, background);
+    play_round(background);
+    check_scene("round", update, dumpDir);
+
+    gfx_diplay_ppm((XRES - 120) / 2, YRES / 3, "player0wins.ppm", 0.6);
+    gfx_present();
+    check_scene("gameover", update, dumpDir);
+
+    // the next round starts from the saved background
+    play_round(background);
+    check_scene("round", update, dumpDir);
+
+    if (update) {
+        save_golden(goldenFile);
+    } else {
+        printf("%s\n", failures ? "FAILED" : "all checks passed");
+    }
+
+    if (bench) {
+        gfx_bench(xres, yres);
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for the kernel build's autoconf.h: the host tools are built
+ * with the default configuration (no CONFIG_APP_TRON_* options set), but
+ * for those the Makefile sets on the command line (see domaincheck).
+ */
+
+#ifndef HOST_AUTOCONF_H_
+#define HOST_AUTOCONF_H_
+
+#endif /* HOST_AUTOCONF_H_ */
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libcpio's cpio.h: files are read from the host's file
+ * system instead of the archive linked into the image; see tools/fb_shim.c.
+ */
+
+#ifndef HOST_CPIO_CPIO_H_
+#define HOST_CPIO_CPIO_H_
+
+void* cpio_get_file(void* archive, const char* name, unsigned long* size);
+
+#endif /* HOST_CPIO_CPIO_H_ */
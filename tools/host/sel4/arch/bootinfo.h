@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libsel4's sel4/arch/bootinfo.h (IA32): the VBE information
+ * the boot loader hands to the root task.
+ */
+
+#ifndef HOST_SEL4_ARCH_BOOTINFO_H_
+#define HOST_SEL4_ARCH_BOOTINFO_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint8_t  signature[4];
+    uint16_t version;
+    uint32_t oemStringPtr;
+    uint32_t capabilities;
+    uint32_t modeListPtr;
+    uint16_t totalMemory;
+    uint16_t oemSoftwareRev;
+    uint32_t oemVendorNamePtr;
+    uint32_t oemProductNamePtr;
+    uint32_t oemProductRevPtr;
+    uint8_t  reserved[222];
+    uint8_t  oemData[256];
+} __attribute__ ((packed)) seL4_VBEInfoBlock;
+
+typedef struct {
+    /* all revisions */
+    uint16_t modeAttr;
+    uint8_t  winAAttr;
+    uint8_t  winBAttr;
+    uint16_t winGranularity;
+    uint16_t winSize;
+    uint16_t winASeg;
+    uint16_t winBSeg;
+    uint32_t winFuncPtr;
+    uint16_t bytesPerScanLine;
+    /* 1.2+ */
+    uint16_t xRes;
+    uint16_t yRes;
+    uint8_t  xCharSize;
+    uint8_t  yCharSize;
+    uint8_t  planes;
+    uint8_t  bitsPerPixel;
+    uint8_t  banks;
+    uint8_t  memoryModel;
+    uint8_t  bankSize;
+    uint8_t  imagePages;
+    uint8_t  reserved1;
+    uint8_t  redLen;
+    uint8_t  redOff;
+    uint8_t  greenLen;
+    uint8_t  greenOff;
+    uint8_t  blueLen;
+    uint8_t  blueOff;
+    uint8_t  rsvdLen;
+    uint8_t  rsvdOff;
+    uint8_t  directColorInfo;
+    /* 2.0+ */
+    uint32_t physBasePtr;
+    uint8_t  reserved2[6];
+    /* 3.0+ */
+    uint16_t linBytesPerScanLine;
+    uint8_t  bnkImagePages;
+    uint8_t  linImagePages;
+    uint8_t  linRedLen;
+    uint8_t  linRedOff;
+    uint8_t  linGreenLen;
+    uint8_t  linGreenOff;
+    uint8_t  linBlueLen;
+    uint8_t  linBlueOff;
+    uint8_t  linRsvdLen;
+    uint8_t  linRsvdOff;
+    uint32_t maxPixelClock;
+    uint16_t modeId;
+    uint8_t  depth;
+} __attribute__ ((packed)) seL4_VBEModeInfoBlock;
+
+typedef struct {
+    seL4_VBEInfoBlock     vbeInfoBlock;
+    seL4_VBEModeInfoBlock vbeModeInfoBlock;
+    uint32_t vbeMode;
+    uint32_t vbeInterfaceSeg;
+    uint32_t vbeInterfaceOff;
+    uint32_t vbeInterfaceLen;
+} seL4_IA32_BootInfo;
+
+#endif /* HOST_SEL4_ARCH_BOOTINFO_H_ */
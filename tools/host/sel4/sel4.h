@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libsel4's sel4/sel4.h: just what src/graphics.c (see
+ * tools/fb_shim.c) and src/aidomain.c (see tools/domain_shim.c) need to be
+ * built on a Linux host.
+ */
+
+#ifndef HOST_SEL4_SEL4_H_
+#define HOST_SEL4_SEL4_H_
+
+#include <stdint.h>
+
+typedef unsigned long seL4_Word;
+typedef seL4_Word seL4_CPtr;
+typedef enum { seL4_NoRights = 0, seL4_CanWrite = 1, seL4_CanRead = 2,
+               seL4_AllRights = 3 } seL4_CapRights;
+
+#define seL4_CapNull 0
+#define seL4_CapInitThreadPD 3
+#define seL4_PageBits 12
+#define BIT(n) (1ul << (n))
+
+typedef enum {
+    seL4_IA32_Default_VMAttributes = 0,
+    seL4_IA32_WriteBack = 0,
+    seL4_IA32_WriteThrough = 1,
+    seL4_IA32_CacheDisabled = 2,
+    seL4_IA32_Uncacheable = 3,
+    seL4_IA32_WriteCombining = 4
+} seL4_IA32_VMAttributes;
+
+int seL4_IA32_Page_Remap(seL4_CPtr service, seL4_CPtr pd,
+        seL4_CapRights rights, seL4_IA32_VMAttributes attr);
+
+/* IPC: the message registers and the user data word are per thread */
+typedef struct {
+    seL4_Word label;
+    seL4_Word length;
+} seL4_MessageInfo_t;
+
+enum { seL4_VMFault = 4 };
+
+seL4_MessageInfo_t seL4_MessageInfo_new(seL4_Word label,
+        seL4_Word capsUnwrapped, seL4_Word extraCaps, seL4_Word length);
+seL4_Word seL4_MessageInfo_get_label(seL4_MessageInfo_t info);
+void seL4_Send(seL4_CPtr dest, seL4_MessageInfo_t info);
+seL4_MessageInfo_t seL4_Wait(seL4_CPtr src, seL4_Word* sender);
+void seL4_SetMR(int i, seL4_Word mr);
+seL4_Word seL4_GetMR(int i);
+void seL4_SetUserData(seL4_Word data);
+seL4_Word seL4_GetUserData(void);
+
+#endif /* HOST_SEL4_SEL4_H_ */
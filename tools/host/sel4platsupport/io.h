@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libsel4platsupport's io.h (and libplatsupport's io.h):
+ * mapping of device memory and I/O ports, backed by tools/fb_shim.c.
+ */
+
+#ifndef HOST_SEL4PLATSUPPORT_IO_H_
+#define HOST_SEL4PLATSUPPORT_IO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum { PS_MEM_NORMAL, PS_MEM_HW } ps_mem_flags_t;
+
+typedef struct {
+    void* cookie;
+} ps_io_mapper_t;
+
+typedef struct {
+    void* cookie;
+} ps_io_port_ops_t;
+
+void* ps_io_map(ps_io_mapper_t* io_mapper, uintptr_t paddr, size_t size,
+        int cached, ps_mem_flags_t flags);
+int ps_io_port_in(const ps_io_port_ops_t* port_ops, uint32_t port,
+        int io_size, uint32_t* result);
+int ps_io_port_out(const ps_io_port_ops_t* port_ops, uint32_t port,
+        int io_size, uint32_t val);
+
+#endif /* HOST_SEL4PLATSUPPORT_IO_H_ */
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libsel4simple's simple.h; see tools/domain_shim.c.
+ */
+
+#ifndef HOST_SIMPLE_SIMPLE_H_
+#define HOST_SIMPLE_SIMPLE_H_
+
+typedef struct simple {
+    void* data;
+} simple_t;
+
+#endif /* HOST_SIMPLE_SIMPLE_H_ */
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libutils' utils/attribute.h, so that the game logic can be
+ * built on a Linux host.
+ */
+
+#ifndef HOST_UTILS_ATTRIBUTE_H_
+#define HOST_UTILS_ATTRIBUTE_H_
+
+#define UNUSED __attribute__((unused))
+
+#endif /* HOST_UTILS_ATTRIBUTE_H_ */
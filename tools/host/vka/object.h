@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libsel4vka's object.h: just the endpoints src/aidomain.c
+ * allocates; see tools/domain_shim.c.
+ */
+
+#ifndef HOST_VKA_OBJECT_H_
+#define HOST_VKA_OBJECT_H_
+
+#include <sel4/sel4.h>
+#include <utils/attribute.h>
+#include <vka/vka.h>
+
+typedef struct {
+    seL4_CPtr cptr;
+} vka_object_t;
+
+int vka_alloc_endpoint(vka_t* vka, vka_object_t* result);
+
+#endif /* HOST_VKA_OBJECT_H_ */
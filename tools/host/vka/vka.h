@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libsel4vka's vka.h; see tools/domain_shim.c.
+ */
+
+#ifndef HOST_VKA_VKA_H_
+#define HOST_VKA_VKA_H_
+
+typedef struct vka {
+    void* data;
+} vka_t;
+
+#endif /* HOST_VKA_VKA_H_ */
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Stand-in for libsel4vspace's vspace.h; see tools/fb_shim.c.
+ */
+
+#ifndef HOST_VSPACE_VSPACE_H_
+#define HOST_VSPACE_VSPACE_H_
+
+#include <sel4/sel4.h>
+
+typedef struct vspace {
+    void* data;
+} vspace_t;
+
+seL4_CPtr vspace_get_cap(vspace_t* vspace, void* vaddr);
+
+#endif /* HOST_VSPACE_VSPACE_H_ */
@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Opening book generator: searches the first moves of a round from the
+ * start position of the game (see init_game_newround() in src/main.c)
+ * and writes them in the format of src/book.c; put the file into the
+ * cpio archive as data/book.bin (see Makefile).
+ *
+ * Usage: mkbook [-s WxH]... [-p plies] [-d depth] -o file
+ *
+ * The book has a section for every board size given with -s (default:
+ * 64x48, 80x60, and 102x76, i.e. 640x480, 800x600, and 1024x768 pixels
+ * with the default cell width). It covers the first "plies" ticks of
+ * either computer player, for every way the opponent may move (apart from
+ * crashing). A computer player decides before the opponent moves in the
+ * same tick, except for BLUE, which also decides after GREEN has moved
+ * (that is the order the game moves players in, unless both players are
+ * computer players on AI threads).
+ *
+ * Every move is chosen by a minimax search "depth" ticks deep, which
+ * assumes the worst: that the opponent knows our move. Positions at the
+ * end are rated by the territory of each player: the empty cells the
+ * player can reach before the other (a Voronoi partition of the board).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "board.h"
+#include "board_shim.h"
+#include "book.h"
+
+#define MAX_SIZES 8
+
+/* score of a won game; -WIN is a lost one */
+#define WIN 1000000
+
+typedef struct {
+    uint64_t key;
+    direction_t dir;
+} entry_t;
+
+static entry_t* entries = NULL;
+static int numEntries = 0;
+static int maxEntries = 0;
+
+static int depth = 3;
+static int plies = 6;
+
+/* statistics */
+static unsigned long nodes = 0;
+
+/* breadth first search: distance and owner of every cell */
+static int* dist;
+static uint8_t* owner;
+static int* queue;
+
+static const coord_t delta[] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+
+/* opposite directions */
+static const direction_t back[] = { East, South, West, North };
+
+
+static void
+add_entry(uint64_t key, direction_t dir) {
+    if (numEntries == maxEntries) {
+        maxEntries = maxEntries ? 2 * maxEntries : 1024;
+        entries = realloc(entries, maxEntries * sizeof(entry_t));
+        if (entries == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+    entries[numEntries++] = (entry_t){ key, dir };
+}
+
+
+/*
+ * Territory of "me" minus territory of "you": a breadth first search
+ * from both heads at once, in which a cell belongs to the player that
+ * gets there first; cells both get to at the same time belong to neither.
+ */
+static int
+evaluate(const player_t* me, const player_t* you) {
+    enum { Nobody, Me, You, Both };
+    int numCells = numCellsX * numCellsY;
+    for (int i = 0; i < numCells; i++) {
+        dist[i] = -1;
+    }
+    int head = 0;
+    int tail = 0;
+    const player_t* pl[] = { me, you };
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        int c = pl[i]->pos.y * numCellsX + pl[i]->pos.x;
+        dist[c] = 0;
+        owner[c] = i == 0 ? Me : You;
+        queue[tail++] = c;
+    }
+    int score = 0;
+    while (head < tail) {
+        int c = queue[head++];
+        if (owner[c] == Both) {
+            continue;
+        }
+        score += dist[c] == 0 ? 0 : owner[c] == Me ? 1 : -1;
+        coord_t pos = { c % numCellsX, c / numCellsX };
+        for (int i = 0; i < DirLength; i++) {
+            coord_t n = { pos.x + delta[i].x, pos.y + delta[i].y };
+            int nc = n.y * numCellsX + n.x;
+            if (dist[nc] < 0) {
+                if (isempty_cell(n)) {
+                    dist[nc] = dist[c] + 1;
+                    owner[nc] = owner[c];
+                    queue[tail++] = nc;
+                }
+            } else if (dist[nc] == dist[c] + 1 && owner[nc] != owner[c]) {
+                owner[nc] = Both;
+            }
+        }
+    }
+    return score;
+}
+
+
+/*
+ * Minimax search with alpha-beta pruning; both players move in each of
+ * the next "d" ticks, "you" knowing the move of "me".
+ * @param best: returns the best move of "me" (if not NULL)
+ * @return: score of the position for "me"
+ */
+static int
+search(player_t* me, player_t* you, int d, int alpha, int beta,
+        direction_t* best) {
+    nodes++;
+    if (d == 0) {
+        return evaluate(me, you);
+    }
+    int bestScore = -WIN - 1;
+    direction_t mine = me->direction;
+    direction_t yours = you->direction;
+    for (direction_t md = West; md < DirLength; md++) {
+        if (md == back[mine]) {
+            continue;
+        }
+        int worst = WIN + 1;
+        for (direction_t yd = West; yd < DirLength && worst > alpha; yd++) {
+            if (yd == back[yours]) {
+                continue;
+            }
+            int meCrashed = move_apply(me, md);
+            int youCrashed = move_apply(you, yd);
+            if (me->pos.x == you->pos.x && me->pos.y == you->pos.y) {
+                // head-on: both crash
+                meCrashed = youCrashed = 1;
+            }
+            int score;
+            if (meCrashed || youCrashed) {
+                // crashing later is better than crashing now
+                score = meCrashed == youCrashed ? 0
+                      : meCrashed ? -WIN + (depth - d) : WIN - (depth - d);
+            } else {
+                score = search(me, you, d - 1, alpha,
+                        worst < beta ? worst : beta, NULL);
+            }
+            move_undo();
+            move_undo();
+            if (score < worst) {
+                worst = score;
+            }
+        }
+        if (worst > bestScore) {
+            bestScore = worst;
+            if (best != NULL) {
+                *best = md;
+            }
+            if (bestScore > alpha) {
+                alpha = bestScore;
+            }
+            if (alpha >= beta) {
+                break;
+            }
+        }
+    }
+    return bestScore;
+}
+
+
+static void expand(player_t* me, player_t* you, int ply, int youFirst);
+
+
+/*
+ * Search and record the move of "me", make it, and go on with the next
+ * tick (after the opponent's moves, unless the opponent moved first).
+ */
+static void
+decide(player_t* me, player_t* you, int ply, int youFirst) {
+    direction_t dir = me->direction;
+    search(me, you, depth, -WIN - 1, WIN + 1, &dir);
+    add_entry(book_key(me, you), dir);
+    if (move_apply(me, dir) == 0) {
+        if (youFirst) {
+            expand(me, you, ply + 1, youFirst);
+        } else {
+            for (direction_t yd = West; yd < DirLength; yd++) {
+                if (yd == back[you->direction]) {
+                    continue;
+                }
+                if (move_apply(you, yd) == 0) {
+                    expand(me, you, ply + 1, youFirst);
+                }
+                move_undo();
+            }
+        }
+    }
+    move_undo();
+}
+
+
+/*
+ * Record the moves of "me" in tick "ply" and after, for every way the
+ * opponent may move.
+ * @param youFirst: the opponent moves before "me" decides
+ */
+static void
+expand(player_t* me, player_t* you, int ply, int youFirst) {
+    if (ply == plies) {
+        return;
+    }
+    if (!youFirst) {
+        decide(me, you, ply, youFirst);
+        return;
+    }
+    for (direction_t yd = West; yd < DirLength; yd++) {
+        if (yd == back[you->direction]) {
+            continue;
+        }
+        if (move_apply(you, yd) == 0) {
+            decide(me, you, ply, youFirst);
+        }
+        move_undo();
+    }
+}
+
+
+static int
+compare_entries(const void* a, const void* b) {
+    uint64_t x = ((const entry_t*)a)->key;
+    uint64_t y = ((const entry_t*)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+
+static void
+put(FILE* f, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        fputc((v >> (8 * i)) & 0xff, f);
+    }
+}
+
+
+/*
+ * Build the book for a board of w x h cells, and append it to file f.
+ */
+static void
+make_section(FILE* f, int w, int h) {
+    board_init(w, h);
+    dist = realloc(dist, w * h * sizeof(int));
+    owner = realloc(owner, w * h);
+    queue = realloc(queue, w * h * sizeof(int));
+    numEntries = 0;
+    nodes = 0;
+    uint64_t start = get_current_time();
+
+    // the start position; see init_game_newround()
+    player_t pl[NUMPLAYERS];
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        pl[i] = (player_t) {
+            .pos = { w * (3 - 2 * i) / 4, h / 2 },
+            .direction = North,
+            .entity = i == 0 ? CELL_P0 : CELL_P1,
+        };
+        put_board(pl[i].pos, pl[i].entity);
+    }
+    expand(&pl[0], &pl[1], 0, 0);
+    expand(&pl[1], &pl[0], 0, 0);
+    expand(&pl[1], &pl[0], 0, 1);
+
+    // positions reached in more than one way are searched more than once
+    qsort(entries, numEntries, sizeof(entry_t), compare_entries);
+    int n = 0;
+    for (int i = 0; i < numEntries; i++) {
+        if (n == 0 || entries[i].key != entries[n - 1].key) {
+            entries[n++] = entries[i];
+        }
+    }
+
+    // at most half full, so that lookups find an empty slot soon
+    uint32_t numSlots = 1;
+    while (numSlots < 2 * (uint32_t)n) {
+        numSlots *= 2;
+    }
+    uint64_t* slots = calloc(numSlots, sizeof(uint64_t));
+    for (int i = 0; i < n; i++) {
+        uint32_t s = entries[i].key % numSlots;
+        while (slots[s] != 0) {
+            s = (s + 1) % numSlots;
+        }
+        slots[s] = entries[i].key | entries[i].dir;
+    }
+    put(f, w, 2);
+    put(f, h, 2);
+    put(f, numSlots, 4);
+    for (uint32_t i = 0; i < numSlots; i++) {
+        put(f, slots[i], 8);
+    }
+    free(slots);
+    printf("%d x %d: %d positions, %u slots (%u bytes), %lu nodes, %.1f s\n",
+            w, h, n, (unsigned)numSlots, (unsigned)numSlots * 8, nodes,
+            (get_current_time() - start) / 1e9);
+}
+
+
+/*
+ * Check that every move in the book can be looked up again.
+ */
+static int
+verify(const char* file, int w, int h) {
+    FILE* f = fopen(file, "rb");
+    if (f == NULL) {
+        perror(file);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t* data = malloc(size);
+    if (fread(data, 1, size, f) != (size_t)size) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    // entries[] still holds the positions of the last section
+    board_init(w, h);
+    if (book_load(data, size) != 0) {
+        return -1;
+    }
+    player_t pl[NUMPLAYERS];
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        pl[i] = (player_t) {
+            .pos = { w * (3 - 2 * i) / 4, h / 2 },
+            .direction = North,
+            .entity = i == 0 ? CELL_P0 : CELL_P1,
+        };
+        put_board(pl[i].pos, pl[i].entity);
+    }
+    int ok = book_lookup(&pl[0], &pl[1]) >= 0 && book_lookup(&pl[1], &pl[0]) >= 0;
+    free(data);
+    return ok ? 0 : -1;
+}
+
+
+int
+main(int argc, char** argv) {
+    int w[MAX_SIZES];
+    int h[MAX_SIZES];
+    int numSizes = 0;
+    const char* outFile = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:d:o:")) != -1) {
+        switch (opt) {
+        case 's':
+            if (numSizes == MAX_SIZES
+            || sscanf(optarg, "%dx%d", &w[numSizes], &h[numSizes]) != 2
+            || w[numSizes] < 8 || h[numSizes] < 8) {
+                fprintf(stderr, "invalid size: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            numSizes++;
+            break;
+        case 'p': plies = atoi(optarg); break;
+        case 'd': depth = atoi(optarg); break;
+        case 'o': outFile = optarg; break;
+        default:
+            outFile = NULL;
+            break;
+        }
+    }
+    if (outFile == NULL || plies < 1 || depth < 1) {
+        fprintf(stderr, "usage: %s [-s WxH]... [-p plies] [-d depth] "
+                "-o file\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (numSizes == 0) {
+        static const int defaults[][2] = { {64, 48}, {80, 60}, {102, 76} };
+        for (numSizes = 0; numSizes < 3; numSizes++) {
+            w[numSizes] = defaults[numSizes][0];
+            h[numSizes] = defaults[numSizes][1];
+        }
+    }
+
+    FILE* f = fopen(outFile, "wb");
+    if (f == NULL) {
+        perror(outFile);
+        return EXIT_FAILURE;
+    }
+    fwrite("TRBK", 1, 4, f);
+    fputc(BOOK_VERSION, f);
+    fputc(numSizes, f);
+    for (int i = 0; i < numSizes; i++) {
+        make_section(f, w[i], h[i]);
+    }
+    long size = ftell(f);
+    fclose(f);
+    if (verify(outFile, w[numSizes - 1], h[numSizes - 1]) != 0) {
+        fprintf(stderr, "%s: cannot read the book back\n", outFile);
+        return EXIT_FAILURE;
+    }
+    printf("wrote %s (%ld bytes; %d plies, %d ticks deep)\n", outFile, size,
+            plies, depth);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2015, Josef Mihalits
+ *
+ * This software may be distributed and modified according to the terms of
+ * the BSD 2-Clause license. Note that NO WARRANTY is provided.
+ * See "COPYING" for details.
+ *
+ */
+
+/*
+ * Position generator: plays games between two computer players on the
+ * board of the default game (64x48 cells) and writes positions of these
+ * games in the format of aibench, for the AI benchmark.
+ *
+ * Usage: mkpos [-n positions] [-l level] [-s seed] [-e weights] -o file
+ *
+ * A position is taken when the cells the player to move can move to are
+ * in different regions of empty cells (see region_size() in src/board.c),
+ * and one region is much larger than the others and than the opponent's
+ * (so that the opponent outlasts a player in a small region): the move
+ * into the large region is "best" and the only one that is "safe". Half
+ * of the positions have small regions larger than the cutoff of the flood
+ * fill at level "normal", where only looking further than the cutoff (the
+ * occupancy pyramid, or the region sizes at level "hard") finds the best
+ * move.
+ *
+ * The games are played like aitune plays them (both players decide on
+ * the same board in every tick), at difficulty level "level" (default:
+ * the game's default); -e loads the evaluation function, as the game
+ * does. At most one position is taken from every game.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "board.h"
+#include "board_shim.h"
+#include "evaluate.h"
+#include "oppmodel.h"
+
+/* board of the default game: 640x480 pixels, cell width 10 */
+#define BOARD_W 64
+#define BOARD_H 48
+
+/* a game longer than this (ticks) is given up */
+#define MAX_TICKS (BOARD_W * BOARD_H)
+
+/* a small region: at most half the size of the large one, minus this */
+#define MARGIN 20
+
+/* the opponent's head is at least this far from the cells to move to, so
+ * that it does not decide the position */
+#define MIN_DISTANCE 4
+
+/* cutoff of the flood fill at level "normal" (see aiLevels in gameai.c) */
+#define NORMAL_CUTOFF 100
+
+static const char* dirchars = "WNES";
+
+static const direction_t back[] = { East, South, West, North };
+
+/* the games differ by their seed */
+static uint32_t seed = 1;
+
+
+static uint32_t
+mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+
+static coord_t
+step(coord_t pos, direction_t dir) {
+    static const coord_t delta[] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+    return (coord_t){pos.x + delta[dir].x, pos.y + delta[dir].y};
+}
+
+
+/*
+ * Check whether "me" (to move, opponent "you") is in a position worth
+ * taking (see above).
+ * @param best: returns the direction into the large region
+ * @param small: returns the size of the largest of the small regions
+ * @return: 1 if so, else 0
+ */
+static int
+is_split(player_t* me, player_t* you, direction_t* best, int* small) {
+    int large = 0;
+    int numLarge = 0;
+    *small = 0;
+    for (direction_t d = West; d < DirLength; d++) {
+        coord_t pos = step(me->pos, d);
+        if (d == back[me->direction] || !isempty_cell(pos)) {
+            continue;
+        }
+        if (abs(pos.x - you->pos.x) + abs(pos.y - you->pos.y) < MIN_DISTANCE) {
+            return 0;
+        }
+        int size = region_size(pos);
+        if (size > large) {
+            *small = large > *small ? large : *small;
+            large = size;
+            numLarge = 1;
+            *best = d;
+        } else if (size == large) {
+            numLarge++;
+        } else if (size > *small) {
+            *small = size;
+        }
+    }
+    if (numLarge != 1 || *small == 0 || 2 * *small + MARGIN > large) {
+        return 0;
+    }
+    // in a small region, we lose unless the opponent is stuck in one too
+    int yours = 0;
+    for (direction_t d = West; d < DirLength; d++) {
+        coord_t pos = step(you->pos, d);
+        if (isempty_cell(pos) && region_size(pos) > yours) {
+            yours = region_size(pos);
+        }
+    }
+    return 2 * *small + MARGIN <= yours;
+}
+
+
+/*
+ * Write the position of "pl" to file "f"; player "tomove" to move.
+ */
+static void
+write_position(FILE* f, player_t* pl, int tomove, direction_t best,
+        int game, int tick) {
+    player_t* me = &pl[tomove];
+    fprintf(f, "\n# game %d, tick %d; region sizes:", game, tick);
+    for (direction_t d = West; d < DirLength; d++) {
+        coord_t pos = step(me->pos, d);
+        if (d != back[me->direction] && isempty_cell(pos)) {
+            fprintf(f, " %c=%d", dirchars[d], region_size(pos));
+        }
+    }
+    fprintf(f, "\nposition game%d-%d\n", game, tick);
+    fprintf(f, "size %d %d\nboard\n", numCellsX, numCellsY);
+    for (int y = 0; y < numCellsY; y++) {
+        for (int x = 0; x < numCellsX; x++) {
+            cell_t c = get_cell((coord_t){x, y});
+            fputc(c == CELL_WALL ? '#' : c == CELL_P0 ? 'g'
+                    : c == CELL_P1 ? 'b' : '.', f);
+        }
+        fputc('\n', f);
+    }
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        fprintf(f, "p%d %d %d %c\n", i, pl[i].pos.x, pl[i].pos.y,
+                dirchars[pl[i].direction]);
+    }
+    fprintf(f, "tomove p%d\nsafe %c\nbest %c\nend\n", tomove,
+            dirchars[best], dirchars[best]);
+}
+
+
+/*
+ * Play game "game" until one of the players is in a position worth taking,
+ * and write it if the position is of the kind still wanted.
+ * @param wanted: number of positions still wanted with a small region up
+ *                to the cutoff of level "normal" (index 0), and larger
+ * @return: 1 if a position was written, else 0
+ */
+static int
+play_game(FILE* f, int game, int wanted[2]) {
+    uint32_t s = mix(seed) + game;
+    player_t pl[NUMPLAYERS];
+    board_reset();
+    opp_model_newgame();
+    forget_computer_upkeep();
+    for (int i = 0; i < NUMPLAYERS; i++) {
+        pl[i] = (player_t) {
+            .pos = { numCellsX * (3 - 2 * i) / 4,
+                     numCellsY / 4 + mix(s + i) % (numCellsY / 2) },
+            .direction = North,
+            .entity = i == 0 ? CELL_P0 : CELL_P1,
+            .name = i == 0 ? "GREEN" : "BLUE",
+            .rng = mix(s * 2 + i) | 1
+        };
+        put_board(pl[i].pos, pl[i].entity);
+    }
+    for (int t = 0; t < MAX_TICKS; t++) {
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            direction_t best = West;
+            int small;
+            if (is_split(&pl[i], &pl[1 - i], &best, &small)
+            && wanted[small > NORMAL_CUTOFF] > 0) {
+                wanted[small > NORMAL_CUTOFF]--;
+                write_position(f, pl, i, best, game, t);
+                return 1;
+            }
+        }
+        direction_t dir[NUMPLAYERS];
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            dir[i] = get_computer_move(UINT64_MAX, &pl[i], &pl[1 - i]);
+        }
+        int crashed = 0;
+        for (int i = 0; i < NUMPLAYERS; i++) {
+            crashed |= move_apply(&pl[i], dir[i]);
+        }
+        if (crashed) {
+            break;
+        }
+    }
+    return 0;
+}
+
+
+/*
+ * Load the weights of the evaluation function from file "file".
+ */
+static void
+load_weights(const char* file) {
+    static char text[1024];
+    FILE* f = fopen(file, "r");
+    if (f == NULL) {
+        perror(file);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = fread(text, 1, sizeof(text), f);
+    fclose(f);
+    if (eval_load(text, size) != 0) {
+        fprintf(stderr, "%s: invalid weights\n", file);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+int
+main(int argc, char** argv) {
+    int count = 32;
+    int level = get_computer_level();
+    const char* outFile = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:s:e:o:")) != -1) {
+        switch (opt) {
+        case 'n': count = atoi(optarg); break;
+        case 'l': level = atoi(optarg); break;
+        case 's': seed = atoi(optarg); break;
+        case 'e': load_weights(optarg); break;
+        case 'o': outFile = optarg; break;
+        default:
+            outFile = NULL;
+            break;
+        }
+    }
+    if (outFile == NULL || count < 1 || level < 0 || level >= AI_LEVELS) {
+        fprintf(stderr, "usage: %s [-n positions] [-l level] [-s seed] "
+                "[-e weights] -o file\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    FILE* f = fopen(outFile, "w");
+    if (f == NULL) {
+        perror(outFile);
+        return EXIT_FAILURE;
+    }
+
+    board_init(BOARD_W, BOARD_H);
+    init_computer_move();
+    set_computer_level(level);
+
+    fprintf(f, "# Positions of games between computer players (level %s) "
+            "on the\n# default %dx%d board, written by tools/mkpos: the "
+            "player to move\n# can move into regions of different size; "
+            "the move into the\n# largest is the best and only safe one.\n",
+            get_computer_level_name(level), BOARD_W, BOARD_H);
+    int wanted[2] = { count / 2, count - count / 2 };
+    int written = 0;
+    int games = 0;
+    while (written < count && games < 1000 * count) {
+        written += play_game(f, games, wanted);
+        games++;
+    }
+    fclose(f);
+    printf("wrote %s (%d positions from %d games)\n", outFile, written,
+            games);
+    return written == count ? EXIT_SUCCESS : EXIT_FAILURE;
+}